@@ -0,0 +1,170 @@
+#define _GNU_SOURCE     // sched_getaffinity, CPU_* macros
+#include "affinity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+typedef enum { AFF_OFF = 0, AFF_COMPACT, AFF_SPREAD, AFF_LIST } aff_policy_t;
+
+typedef struct {
+    int cpu, node, package, core;
+} cpu_info_t;
+
+static aff_policy_t g_policy = AFF_OFF;
+static char         g_spec[128] = "off";
+static int         *g_order;        // CPU for each stage slot
+static int          g_norder;
+
+// Read one integer from a sysfs file; -1 if it is missing
+static int read_int(const char *path) {
+    FILE *f = fopen(path, "re");
+    int v = -1;
+    if (f) {
+        if (fscanf(f, "%d", &v) != 1) v = -1;
+        fclose(f);
+    }
+    return v;
+}
+
+// Parse a kernel CPU list ("0-3,8,10-11") into set; -1 on bad syntax.
+// If order is not NULL it gets each CPU once, in list order (room for
+// CPU_COUNT(set) entries).
+static int parse_cpulist(const char *s, cpu_set_t *set, int *order) {
+    int n = 0;
+    CPU_ZERO(set);
+    while (*s && *s != '\n') {
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (end == s || lo < 0) return -1;
+        if (*end == '-') {
+            s = end + 1;
+            hi = strtol(s, &end, 10);
+            if (end == s || hi < lo) return -1;
+        }
+        if (hi >= CPU_SETSIZE) return -1;
+        for (long c = lo; c <= hi; ++c) {
+            if (order && !CPU_ISSET((int)c, set)) order[n++] = (int)c;
+            CPU_SET((int)c, set);
+        }
+        s = end;
+        if (*s == ',') s++;
+        else if (*s && *s != '\n') return -1;
+    }
+    return 0;
+}
+
+static int node_of(int cpu) {
+    char path[96];
+    for (int node = 0; node < 1024; ++node) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *f = fopen(path, "re");
+        if (!f) {
+            if (node == 0) return 0;    // no NUMA support: one node
+            continue;
+        }
+        char line[4096];
+        cpu_set_t set;
+        int hit = fgets(line, sizeof(line), f) && parse_cpulist(line, &set, NULL) == 0 &&
+                  CPU_ISSET(cpu, &set);
+        fclose(f);
+        if (hit) return node;
+    }
+    return 0;
+}
+
+static int cmp_compact(const void *a, const void *b) {
+    const cpu_info_t *x = a, *y = b;
+    if (x->node    != y->node)    return x->node    - y->node;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core    != y->core)    return x->core    - y->core;
+    return x->cpu - y->cpu;
+}
+
+// Usable CPUs with their topology, in compact order
+static int load_topology(cpu_info_t **out) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) return -1;
+
+    int n = CPU_COUNT(&allowed), k = 0;
+    cpu_info_t *v = malloc(sizeof(*v) * (size_t)(n ? n : 1));
+    if (!v) return -1;
+    for (int cpu = 0; cpu < CPU_SETSIZE && k < n; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        char path[96];
+        v[k].cpu  = cpu;
+        v[k].node = node_of(cpu);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        v[k].package = read_int(path);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        v[k].core = read_int(path);
+        k++;
+    }
+    qsort(v, (size_t)k, sizeof(*v), cmp_compact);
+    *out = v;
+    return k;
+}
+
+static int cmp_spread(const void *a, const void *b) {
+    const cpu_info_t *x = a, *y = b;
+    // core holds the CPU's rank within its node here
+    if (x->core != y->core) return x->core - y->core;
+    return x->node - y->node;
+}
+
+// Reorder compact-ordered CPUs so consecutive slots alternate nodes
+static void spread_order(cpu_info_t *v, int n) {
+    for (int i = 0, rank = 0; i < n; ++i) {
+        rank = (i > 0 && v[i].node == v[i - 1].node) ? rank + 1 : 0;
+        v[i].core = rank;
+    }
+    qsort(v, (size_t)n, sizeof(*v), cmp_spread);
+}
+
+int affinity_set(const char *spec) {
+    aff_policy_t p;
+    if      (strcmp(spec, "off")     == 0) p = AFF_OFF;
+    else if (strcmp(spec, "compact") == 0) p = AFF_COMPACT;
+    else if (strcmp(spec, "spread")  == 0) p = AFF_SPREAD;
+    else                                   p = AFF_LIST;
+    if (strlen(spec) >= sizeof(g_spec)) return -1;
+
+    int *order = NULL, n = 0;
+    if (p == AFF_LIST) {
+        cpu_set_t set, allowed;
+        if (parse_cpulist(spec, &set, NULL) < 0 || CPU_COUNT(&set) == 0) return -1;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) return -1;
+        int total = CPU_COUNT(&set);
+        order = malloc(sizeof(int) * (size_t)total);
+        if (!order) return -1;
+        // stages follow the list as written: "3,1,2" puts stage 0 on CPU 3
+        parse_cpulist(spec, &set, order);
+        for (int i = 0; i < total; ++i)
+            if (CPU_ISSET(order[i], &allowed)) order[n++] = order[i];
+        if (n == 0) { free(order); return -1; }
+    } else if (p != AFF_OFF) {
+        cpu_info_t *v;
+        if ((n = load_topology(&v)) <= 0) return -1;
+        if (p == AFF_SPREAD) spread_order(v, n);
+        order = malloc(sizeof(int) * (size_t)n);
+        if (!order) { free(v); return -1; }
+        for (int i = 0; i < n; ++i) order[i] = v[i].cpu;
+        free(v);
+    }
+
+    free(g_order);
+    g_order  = order;
+    g_norder = n;
+    g_policy = p;
+    snprintf(g_spec, sizeof(g_spec), "%s", spec);
+    return 0;
+}
+
+void affinity_show(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_spec);
+}
+
+int affinity_stage_cpu(int stage) {
+    if (g_policy == AFF_OFF || g_norder == 0 || stage < 0) return 0;
+    return 1 + g_order[stage % g_norder];
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+
+// CPU placement of pipeline stages (`shopt affinity <policy>`):
+//   off       leave placement to the scheduler
+//   compact   stage i on the i-th CPU in (node, package, core) order, so
+//             neighbouring stages share a core's siblings and a node's L3
+//   spread    round-robin stages across NUMA nodes
+//   0,2,8-11  pin stage i to the i-th CPU of an explicit list
+// CPUs outside the shell's own affinity mask are never used.
+
+// Returns 0, or -1 if spec is not a policy or a CPU list
+int affinity_set(const char *spec);
+void affinity_show(char *buf, size_t n);
+
+// CPU for stage `stage` of a pipeline under the current policy, as
+// 1 + cpu number (0 = do not pin); see spawn_req_t.pin_cpu
+int affinity_stage_cpu(int stage);
@@ -0,0 +1,62 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_MIN (16 * 1024)
+#define ARENA_ALIGN(n)  (((n) + 15u) & ~(size_t)15u)
+
+void *arena_alloc(arena_t *a, size_t n) {
+    n = ARENA_ALIGN(n ? n : 1);
+
+    // walk forward through blocks kept from before the last reset
+    while (a->cur && a->cur->size - a->cur->used < n && a->cur->next) {
+        a->cur = a->cur->next;
+        a->cur->used = 0;
+    }
+
+    if (!a->cur || a->cur->size - a->cur->used < n) {
+        size_t sz = n > ARENA_BLOCK_MIN ? n : ARENA_BLOCK_MIN;
+        arena_block_t *b = malloc(sizeof(arena_block_t) + sz);
+        if (!b) return NULL;
+        b->next = NULL;
+        b->size = sz;
+        b->used = 0;
+        if (a->cur) a->cur->next = b;
+        else        a->head = b;
+        a->cur = b;
+    }
+
+    void *p = a->cur->data + a->cur->used;
+    a->cur->used += n;
+    return p;
+}
+
+char *arena_strndup(arena_t *a, const char *s, size_t len) {
+    char *d = arena_alloc(a, len + 1);
+    if (!d) return NULL;
+    memcpy(d, s, len);
+    d[len] = '\0';
+    return d;
+}
+
+void arena_reset(arena_t *a) {
+    a->cur = a->head;
+    if (a->cur) a->cur->used = 0;
+}
+
+arena_mark_t arena_mark(const arena_t *a) {
+    arena_mark_t m = { a->cur, a->cur ? a->cur->used : 0 };
+    return m;
+}
+
+void arena_release(arena_t *a, arena_mark_t m) {
+    if (!m.blk) { arena_reset(a); return; }
+    a->cur = m.blk;
+    a->cur->used = m.used;
+}
+
+void arena_free(arena_t *a) {
+    arena_block_t *b = a->head;
+    while (b) { arena_block_t *nx = b->next; free(b); b = nx; }
+    a->head = a->cur = NULL;
+}
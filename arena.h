@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+
+// Bump allocator. Memory is handed out from blocks that are kept across
+// arena_reset(), so a reused arena stops calling malloc once it has grown
+// to its working size.
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t              size;
+    size_t              used;
+    char                data[];
+} arena_block_t;
+
+typedef struct {
+    arena_block_t *head;
+    arena_block_t *cur;
+} arena_t;
+
+#define ARENA_INIT { NULL, NULL }
+
+// Position to roll back to; lets nested users share one arena
+typedef struct {
+    arena_block_t *blk;
+    size_t         used;
+} arena_mark_t;
+
+// n bytes, 16-byte aligned; NULL on OOM
+void *arena_alloc(arena_t *a, size_t n);
+
+// strdup into the arena (len bytes of s, NUL-terminated)
+char *arena_strndup(arena_t *a, const char *s, size_t len);
+
+// Forget every allocation, keep the blocks
+void arena_reset(arena_t *a);
+
+// Remember the current position / forget everything allocated since it
+arena_mark_t arena_mark(const arena_t *a);
+void arena_release(arena_t *a, arena_mark_t m);
+
+// Give the blocks back to malloc
+void arena_free(arena_t *a);
@@ -0,0 +1,286 @@
+#include "batch.h"
+#include "arena.h"
+#include "parser.h"
+#include "shell.h"      // g_last_cmdline
+#include "executor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int g_batch_mode = 0;
+
+static int is_special(char c) {
+    return c == '|' || c == '<' || c == '>' || c == '&' || c == ';';
+}
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// One word starting at *pp (quotes '...' and "..." are stripped); *literal
+// is set if a '$' in it was single-quoted
+static char *read_word(arena_t *a, const char **pp, const char *end, int *literal) {
+    const char *p = *pp;
+    // worst case the word is the rest of the line
+    char *w = arena_alloc(a, (size_t)(end - p) + 1), *o = w;
+    if (!w) return NULL;
+    *literal = 0;
+    while (p < end && !is_blank(*p) && !is_special(*p)) {
+        if (*p == '\'' || *p == '"') {
+            char q = *p++;
+            while (p < end && *p != q) {
+                if (q == '"' && *p == '\\' && p + 1 < end) p++;
+                if (q == '\'' && *p == '$') *literal = 1;
+                *o++ = *p++;
+            }
+            if (p < end) p++;   // closing quote
+        } else {
+            *o++ = *p++;
+        }
+    }
+    *o = '\0';
+    *pp = p;
+    return w;
+}
+
+// Stage, word and literal-word slots shared by every command on a line.
+// Each word and each NULL terminator uses up at least one input byte, so
+// len+2 of each is always enough.
+typedef struct {
+    char ***seq;
+    char  **words;
+    char  **literal;
+} line_buf_t;
+
+/**
+ * @brief Parses one command of a list, up to `;`, `&`, `&&`, `||` or the
+ *        end of the line, into arena-backed storage
+ * @param op    set to the operator that ended the command
+ * @param flags set to the command's CMD_* bits
+ * @param literal set to the words not to expand (see cmdlist_t), or NULL
+ * @return the command line (l->err set on syntax errors), or NULL for an
+ *         empty command or on OOM
+ */
+static struct cmdline *parse_cmd(arena_t *a, const char **pp, const char *end,
+                                 line_buf_t *b, seq_op_t *op, unsigned *flags, char ***literal) {
+    struct cmdline *l = arena_alloc(a, sizeof(*l));
+    if (!l) return NULL;
+    memset(l, 0, sizeof(*l));
+    char ***seq = b->seq, **words = b->words, **lit = b->literal;
+    l->seq = seq;
+
+    size_t ns = 0, nw = 0, nl = 0;
+    seq[ns++] = &words[nw];
+    char **redir = NULL;
+    const char *p = *pp;
+    *op = SEQ_END;
+    *flags = 0;
+    *literal = NULL;
+
+    while (p < end) {
+        while (p < end && is_blank(*p)) p++;
+        if (p >= end || (*p == '#' )) { p = end; break; }
+
+        int two = p + 1 < end && p[1] == *p;
+        if (*p == ';')             { *op = SEQ_ALWAYS; p++;    break; }
+        if (*p == '&' && two)      { *op = SEQ_AND;    p += 2; break; }
+        if (*p == '|' && two)      { *op = SEQ_OR;     p += 2; break; }
+        if (*p == '&') { l->bg = 1; *op = SEQ_ALWAYS;  p++;    break; }
+
+        if (*p == '|') {
+            if (&words[nw] == seq[ns - 1]) { l->err = "empty command in pipeline"; return l; }
+            words[nw++] = NULL;
+            seq[ns++] = &words[nw];
+            p++;
+            continue;
+        }
+        if (*p == '<') { redir = &l->in;  p++; continue; }
+        if (*p == '>') {
+            if (two) { *flags |= CMD_APPEND; p++; }
+            redir = &l->out;
+            p++;
+            continue;
+        }
+
+        int quoted;
+        char *w = read_word(a, &p, end, &quoted);
+        if (!w) return NULL;
+        if (redir) { *redir = w; redir = NULL; continue; }
+        words[nw++] = w;
+        if (quoted) lit[nl++] = w;
+    }
+    *pp = p;
+    if (redir) { l->err = "missing file for redirection"; return l; }
+
+    words[nw++] = NULL;
+    b->words += nw;
+    if (nw == 1 && ns == 1) return NULL;    // empty command
+    if (&words[nw - 1] == seq[ns - 1]) { l->err = "empty command in pipeline"; return l; }
+    seq[ns++] = NULL;
+    b->seq += ns;
+    if (nl > 0) {
+        lit[nl++] = NULL;
+        b->literal += nl;
+        *literal = lit;
+    }
+    return l;
+}
+
+/**
+ * @brief Parses one script line into a command list
+ * @return the list, or NULL for a blank/comment line, on OOM, or on a
+ *         syntax error (*err set)
+ */
+static cmdlist_t *parse_line(arena_t *a, const char *p, const char *end, const char **err) {
+    size_t max = (size_t)(end - p) + 2;
+    line_buf_t b = {
+        .seq     = arena_alloc(a, sizeof(char **) * max),
+        .words   = arena_alloc(a, sizeof(char *) * max),
+        .literal = arena_alloc(a, sizeof(char *) * max),
+    };
+    if (!b.seq || !b.words || !b.literal) return NULL;
+
+    cmdlist_t *head = NULL, **tail = &head;
+    seq_op_t op = SEQ_END;
+    do {
+        seq_op_t prev = op;
+        unsigned flags;
+        char **literal;
+        struct cmdline *l = parse_cmd(a, &p, end, &b, &op, &flags, &literal);
+        if (l && l->err) { *err = l->err; return NULL; }
+        if (!l) {
+            // only `;` and `&` may end a line
+            if (op == SEQ_END && (prev == SEQ_END || prev == SEQ_ALWAYS)) break;
+            *err = "empty command in list";
+            return NULL;
+        }
+        cmdlist_t *c = arena_alloc(a, sizeof(*c));
+        if (!c) return NULL;
+        c->line    = l;
+        c->op      = op;
+        c->flags   = flags;
+        c->literal = literal;
+        c->next    = NULL;
+        *tail = c;
+        tail  = &c->next;
+    } while (op != SEQ_END);
+    return head;
+}
+
+static int run_line(arena_t *a, const char *p, const char *end, int *last) {
+    while (end > p && (end[-1] == '\n' || end[-1] == '\r')) end--;
+
+    const char *err = NULL;
+    cmdlist_t *list = parse_line(a, p, end, &err);
+    if (err) {
+        fprintf(stderr, "error: %s\n", err);
+        *last = EXIT_FAILURE;
+    } else if (list) {
+        // background jobs are listed under g_last_cmdline
+        size_t n = (size_t)(end - p);
+        if (n >= sizeof(g_last_cmdline)) n = sizeof(g_last_cmdline) - 1;
+        memcpy(g_last_cmdline, p, n);
+        g_last_cmdline[n] = '\0';
+        *last = execute_list(list);
+    }
+    arena_reset(a);
+    return 0;
+}
+
+// Stream a non-seekable script through one buffer that only grows
+static int run_stream(int fd, arena_t *a) {
+    size_t cap = 64 * 1024, len = 0;
+    char *buf = malloc(cap);
+    if (!buf) { perror("batch"); return EXIT_FAILURE; }
+
+    int last = EXIT_SUCCESS;
+    for (;;) {
+        if (len == cap) {
+            char *nb = realloc(buf, cap * 2);   // a line longer than the buffer
+            if (!nb) { perror("batch"); break; }
+            buf = nb;
+            cap *= 2;
+        }
+        ssize_t r = read(fd, buf + len, cap - len);
+        if (r < 0) { if (errno == EINTR) continue; perror("batch: read"); break; }
+        if (r == 0) {
+            if (len > 0) run_line(a, buf, buf + len, &last);
+            break;
+        }
+        len += (size_t)r;
+
+        char *start = buf, *nl;
+        while ((nl = memchr(start, '\n', (size_t)(buf + len - start)))) {
+            run_line(a, start, nl, &last);
+            start = nl + 1;
+        }
+        len = (size_t)(buf + len - start);
+        memmove(buf, start, len);
+    }
+    free(buf);
+    return last;
+}
+
+int batch_run_fd(int fd) {
+    arena_t a = ARENA_INIT;
+    int saved = g_batch_mode;
+    g_batch_mode = 1;
+
+    int last = EXIT_SUCCESS;
+    struct stat st;
+    char *map = NULL;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) map = NULL;
+    }
+
+    if (map) {
+        (void)madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+        const char *p = map, *end = map + st.st_size;
+        while (p < end) {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            if (!nl) nl = end;
+            run_line(&a, p, nl, &last);
+            p = nl + 1;
+        }
+        munmap(map, (size_t)st.st_size);
+    } else {
+        last = run_stream(fd, &a);
+    }
+
+    arena_free(&a);
+    g_batch_mode = saved;
+    return last;
+}
+
+int batch_run_file(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { perror(path); return EXIT_FAILURE; }
+    int rc = batch_run_fd(fd);
+    close(fd);
+    return rc;
+}
+
+int batch_main(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-f") == 0) {
+            if (i + 1 >= argc) { fprintf(stderr, "usage: %s -f script\n", argv[0]); return EXIT_FAILURE; }
+            return batch_run_file(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "-s") == 0) return batch_run_fd(STDIN_FILENO);
+    }
+    return -1;
+}
+
+int builtin_source(char **argv) {
+    if (!argv[1]) {
+        fprintf(stderr, "source: usage: source script\n");
+        return EXIT_FAILURE;
+    }
+    return batch_run_file(argv[1]);
+}
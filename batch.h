@@ -0,0 +1,21 @@
+#pragma once
+
+// Non-interactive script execution. Input is mmap'ed (regular files) or
+// streamed through one reused buffer (pipes), and each line is parsed into
+// an arena that is reset after execute(), so steady state does no malloc.
+// Prompting and history are skipped while a script runs.
+
+// Non-zero while a script is being executed
+extern int g_batch_mode;
+
+// Run every line of the script at path / read from fd. Returns the status of
+// the last command (EXIT_FAILURE if the script cannot be read).
+int batch_run_file(const char *path);
+int batch_run_fd(int fd);
+
+// Front-end hook: `-f script` runs a file, `-s` reads the script from stdin.
+// Returns the exit status, or -1 if argv does not ask for batch mode.
+int batch_main(int argc, char **argv);
+
+// `source` builtin: source <script>
+int builtin_source(char **argv);
@@ -0,0 +1,513 @@
+/*
+ * Launch-latency / pipeline-throughput benchmark for executor.c.
+ *
+ * Drives execute() directly with generated struct cmdline values, so it is
+ * linked against the executor sources instead of the interactive front end:
+ *
+ *     cc -O2 -o bench bench.c executor.c jobs.c launcher.c options.c \
+ *        pathcache.c zcopy.c strpool.c history.c trace.c parallel.c \
+ *        forksrv.c arena.c batch.c builtins.c pipebuf.c affinity.c \
+ *        redircache.c uring.c memo.c jobevents.c cgroup.c plan.c \
+ *        histfile.c remote.c out.c
+ *     ./bench [iterations]      # results also go to bench_output.txt
+ *     ./bench --stress [scale]  # load scenarios, checked; to test_output.txt
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <dirent.h>
+#include <stdarg.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "parser.h"
+#include "executor.h"
+#include "launcher.h"
+#include "pipebuf.h"
+#include "jobs.h"       // g_jobs, reap_finished_jobs(), JOBS_DONE_MAX
+#include "forksrv.h"
+
+char g_last_cmdline[256];   // normally owned by the shell front end
+
+static FILE *g_out;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double pct(double *v, int n, double p) {
+    int i = (int)(p * (n - 1) + 0.5);
+    return v[i];
+}
+
+static void report(const char *what, double *v, int n) {
+    qsort(v, (size_t)n, sizeof(double), cmp_double);
+    fprintf(g_out, "%-34s n=%-6d p50=%9.1fus p99=%9.1fus max=%9.1fus\n",
+            what, n, pct(v, n, 0.50), pct(v, n, 0.99), v[n - 1]);
+}
+
+// A cmdline of `nstages` copies of argv, with optional redirections
+static struct cmdline make_line(char ***seq, char **argv, int nstages, char *in, char *out) {
+    for (int i = 0; i < nstages; ++i) seq[i] = argv;
+    seq[nstages] = NULL;
+    struct cmdline l;
+    memset(&l, 0, sizeof(l));
+    l.seq = seq;
+    l.in  = in;
+    l.out = out;
+    return l;
+}
+
+/* ---------- single command launch latency ---------- */
+
+static void bench_launch(int iters) {
+    // a path, so the `true` builtin is not run in the shell instead
+    char *argv[] = { "/bin/true", NULL };
+    char **seq[2];
+    double *v = malloc(sizeof(double) * (size_t)iters);
+    if (!v) return;
+
+    for (int e = SPAWN_FORK; e <= SPAWN_POSIX; ++e) {
+        g_spawn_engine = (spawn_engine_t)e;
+        for (int i = 0; i < iters; ++i) {
+            struct cmdline l = make_line(seq, argv, 1, NULL, NULL);
+            double t0 = now_us();
+            execute(&l);
+            v[i] = now_us() - t0;
+        }
+        char what[64];
+        snprintf(what, sizeof(what), "launch+wait true [%s]", spawn_engine_name(g_spawn_engine));
+        report(what, v, iters);
+    }
+    g_spawn_engine = SPAWN_FORK;
+    free(v);
+}
+
+/* ---------- fork-to-exec: time until the child's main() runs ---------- */
+
+// Child side: print our CLOCK_MONOTONIC in microseconds
+static int stamp_main(void) {
+    printf("%.3f\n", now_us());
+    return 0;
+}
+
+static void bench_fork_to_exec(int iters) {
+    char path[] = "/tmp/bench_stamp_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) { perror("mkstemp"); return; }
+    close(fd);
+
+    char *argv[] = { "/proc/self/exe", "--stamp", NULL };
+    char **seq[2];
+    double *v = malloc(sizeof(double) * (size_t)iters);
+    if (!v) { unlink(path); return; }
+
+    // /proc/self/exe is resolved by the child, i.e. it re-runs this binary
+    for (int e = SPAWN_FORK; e <= SPAWN_POSIX; ++e) {
+        g_spawn_engine = (spawn_engine_t)e;
+        int n = 0;
+        for (int i = 0; i < iters; ++i) {
+            struct cmdline l = make_line(seq, argv, 1, NULL, path);
+            double t0 = now_us();
+            execute(&l);
+            FILE *f = fopen(path, "r");
+            double t1;
+            if (f && fscanf(f, "%lf", &t1) == 1) v[n++] = t1 - t0;
+            if (f) fclose(f);
+        }
+        char what[64];
+        snprintf(what, sizeof(what), "spawn-to-main [%s]", spawn_engine_name(g_spawn_engine));
+        if (n > 0) report(what, v, n);
+    }
+    g_spawn_engine = SPAWN_FORK;
+    free(v);
+    unlink(path);
+}
+
+/* ---------- N-stage pipeline setup ---------- */
+
+static void bench_pipeline_setup(int iters) {
+    char *argv[] = { "/bin/true", NULL };     // fork+execve, not forked builtins
+    char **seq[65];
+    double *v = malloc(sizeof(double) * (size_t)iters);
+    if (!v) return;
+
+    for (int n = 2; n <= 64; n *= 2) {
+        for (int i = 0; i < iters; ++i) {
+            struct cmdline l = make_line(seq, argv, n, NULL, NULL);
+            double t0 = now_us();
+            execute(&l);
+            v[i] = now_us() - t0;
+        }
+        char what[64];
+        snprintf(what, sizeof(what), "pipeline of %d x true", n);
+        report(what, v, iters);
+    }
+    free(v);
+}
+
+/* ---------- throughput ---------- */
+
+#define THROUGHPUT_BYTES (64L << 20)
+
+static void bench_throughput(void) {
+    char path[] = "/tmp/bench_data_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) { perror("mkstemp"); return; }
+    static char block[1 << 16];
+    memset(block, 'x', sizeof(block));
+    for (long done = 0; done < THROUGHPUT_BYTES; done += (long)sizeof(block))
+        if (write(fd, block, sizeof(block)) < 0) { perror("write"); break; }
+    close(fd);
+
+    char *cat_file[] = { "cat", path, NULL };
+    char *cat[]      = { "cat", NULL };
+    char *wc[]       = { "wc", "-c", NULL };
+    char **seq[8];
+
+    // pipe buffer settings to compare (shopt pipesz / pipepacket)
+    static const struct { size_t size; int packet; } cfg[] = {
+        { 0, 0 }, { 256 << 10, 0 }, { 1 << 20, 0 }, { 0, 1 }, { 1 << 20, 1 },
+    };
+
+    // cat FILE | cat x k | wc -c  > /dev/null
+    for (size_t c = 0; c < sizeof(cfg) / sizeof(cfg[0]); ++c) {
+        g_pipe_size   = cfg[c].size;
+        g_pipe_packet = cfg[c].packet;
+        for (int k = 0; k <= 4; k += 2) {
+            int n = 0;
+            seq[n++] = cat_file;
+            for (int i = 0; i < k; ++i) seq[n++] = cat;
+            seq[n++] = wc;
+            seq[n] = NULL;
+
+            struct cmdline l;
+            memset(&l, 0, sizeof(l));
+            l.seq = seq;
+            l.out = "/dev/null";
+
+            double t0 = now_us();
+            execute(&l);
+            double sec = (now_us() - t0) / 1e6;
+            fprintf(g_out, "throughput %d-stage pipesz=%-7zu%s %8.1f MiB/s\n",
+                    n, cfg[c].size, cfg[c].packet ? " packet" : "       ",
+                    (double)THROUGHPUT_BYTES / (1 << 20) / sec);
+        }
+    }
+    g_pipe_size   = 0;
+    g_pipe_packet = 0;
+    unlink(path);
+}
+
+/* ---------- stress (--stress): checked load scenarios ---------- */
+
+static int g_failed;
+
+// One PASS/FAIL line per check
+static void check(int ok, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(g_out, "%s ", ok ? "PASS" : "FAIL");
+    vfprintf(g_out, fmt, ap);
+    fputc('\n', g_out);
+    va_end(ap);
+    fflush(g_out);
+    if (!ok) g_failed++;
+}
+
+static int count_fds(void) {
+    DIR *d = opendir("/proc/self/fd");
+    if (!d) return -1;
+    int n = 0;
+    for (struct dirent *e; (e = readdir(d)) != NULL; ) n += e->d_name[0] != '.';
+    closedir(d);
+    return n - 1;   // the directory's own fd
+}
+
+// 1 when the shell has no children left at all, zombie or running
+static int no_children(void) {
+    siginfo_t si;
+    memset(&si, 0, sizeof(si));
+    return waitid(P_ALL, 0, &si, WEXITED | WNOHANG | WNOWAIT) < 0 && errno == ECHILD;
+}
+
+static int jobs_running(void) {
+    int n = 0;
+    for (int i = 0; i < g_jobs.used; ++i) n += g_jobs.slots[i].active && !g_jobs.slots[i].done;
+    return n;
+}
+
+// Reap every background job; nobody lists them, so the table must keep
+// only the newest JOBS_DONE_MAX
+static void drain_jobs(void) {
+    while (reap_finished_jobs(), jobs_running() > 0) usleep(1000);
+}
+
+// Stop the fork server, if a launch started it: the helper is a child of
+// the shell and holds a socket, which the zombie and fd checks would count
+static void stop_server(void) {
+    if (g_spawn_engine == SPAWN_SERVER) forksrv_stop();
+}
+
+static struct cmdline bg_line(char ***seq, char **argv) {
+    struct cmdline l = make_line(seq, argv, 1, NULL, NULL);
+    l.bg = 1;
+    return l;
+}
+
+static void stress_bg_jobs(int scale) {
+    char *argv[] = { "/bin/true", NULL };
+    char **seq[2];
+    const char *eng = spawn_engine_name(g_spawn_engine);
+
+    // the first job creates the job table's epoll fd, which then stays
+    struct cmdline warm = bg_line(seq, argv);
+    execute(&warm);
+    drain_jobs();
+    stop_server();
+    int fds = count_fds();
+
+    for (int n = scale / 8; n <= scale; n *= 2) {
+        double t0 = now_us();
+        int failed = 0;
+        for (int i = 0; i < n; ++i) {
+            struct cmdline l = bg_line(seq, argv);
+            failed += execute(&l) != 0;
+        }
+        double t1 = now_us();
+        drain_jobs();
+        double t2 = now_us();
+        stop_server();
+        fprintf(g_out, "curve bg-jobs %-6s n=%-6d launch=%9.1fms drain=%9.1fms per-job=%7.1fus\n",
+                eng, n, (t1 - t0) / 1e3, (t2 - t1) / 1e3, (t2 - t0) / n);
+        check(failed == 0, "bg-jobs %s n=%d: every launch succeeded (%d failed)", eng, n, failed);
+        check(g_jobs.nactive == g_jobs.ndone && g_jobs.ndone <= JOBS_DONE_MAX && no_children(),
+              "bg-jobs %s n=%d: at most %d finished jobs kept (%d), no zombies",
+              eng, n, JOBS_DONE_MAX, g_jobs.nactive);
+        check(count_fds() == fds, "bg-jobs %s n=%d: no leaked fds (%d -> %d)", eng, n, fds, count_fds());
+    }
+}
+
+static void stress_pipelines(void) {
+    char *argv[] = { "/bin/true", NULL };
+    char **seq[257];
+    const char *eng = spawn_engine_name(g_spawn_engine);
+    int fds = count_fds();
+
+    for (int n = 32; n <= 256; n *= 2) {
+        struct cmdline l = make_line(seq, argv, n, NULL, NULL);
+        double t0 = now_us();
+        int rc = execute(&l);
+        double t1 = now_us();
+        stop_server();
+        int bad = g_npipestatus != n;
+        for (int i = 0; i < g_npipestatus; ++i) bad += g_pipestatus[i] != 0;
+        fprintf(g_out, "curve pipeline %-6s stages=%-4d wall=%9.1fms per-stage=%7.1fus\n",
+                eng, n, (t1 - t0) / 1e3, (t1 - t0) / n);
+        check(rc == 0 && !bad, "pipeline %s %d stages: status 0, PIPESTATUS all 0", eng, n);
+        check(no_children() && count_fds() == fds, "pipeline %s %d stages: no zombies or leaked fds", eng, n);
+    }
+}
+
+// A stage that is not found partway through: only that stage fails (127),
+// with or without a barrier; the rest of the pipeline runs
+static void stress_pipe_fail(void) {
+    char *argv[] = { "/bin/true", NULL };
+    char *missing[] = { "bench-no-such-command", NULL };
+    char **seq[257];
+    int fds = count_fds();
+
+    for (int barrier = 0; barrier <= 1; ++barrier) {
+        g_pipeline_barrier = barrier;
+        for (int n = 8; n <= 256; n *= 2) {
+            struct cmdline l = make_line(seq, argv, n, NULL, NULL);
+            seq[n / 2] = missing;
+            double t0 = now_us();
+            int rc = execute(&l);
+            double t1 = now_us();
+            int bad = g_npipestatus != n;
+            for (int i = 0; i < g_npipestatus; ++i) bad += g_pipestatus[i] != (i == n / 2 ? 127 : 0);
+            fprintf(g_out, "curve pipe-fail%s stages=%-4d at=%-4d wall=%9.1fms\n",
+                    barrier ? "+barrier" : "", n, n / 2, (t1 - t0) / 1e3);
+            check(rc == 0 && !bad, "pipe-fail%s %d stages: 127 at stage %d only, 0 elsewhere",
+                  barrier ? "+barrier" : "", n, n / 2);
+            check(no_children() && count_fds() == fds, "pipe-fail%s %d stages: no zombies or leaked fds",
+                  barrier ? "+barrier" : "", n);
+        }
+    }
+    g_pipeline_barrier = 0;
+}
+
+static volatile sig_atomic_t g_nchld;
+static void on_chld(int sig) { (void)sig; g_nchld++; }
+
+// Background jobs exit while a foreground command is waited for; the
+// handler has no SA_RESTART, so every SIGCHLD interrupts the wait
+static void stress_sigchld(int scale) {
+    char *argv[] = { "/bin/true", NULL };
+    char *fg[] = { "sh", "-c", "sleep 0.2; exit 7", NULL };
+    char **seq[2];
+    int fds = count_fds();
+
+    struct sigaction sa, old;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_chld;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, &old);
+
+    for (int n = scale / 16; n <= scale / 2; n *= 2) {
+        g_nchld = 0;
+        double t0 = now_us();
+        for (int i = 0; i < n; ++i) {
+            struct cmdline l = bg_line(seq, argv);
+            execute(&l);
+        }
+        struct cmdline l = make_line(seq, fg, 1, NULL, NULL);
+        int rc = execute(&l);
+        drain_jobs();
+        fprintf(g_out, "curve sigchld jobs=%-6d signals=%-6d wall=%9.1fms\n",
+                n, (int)g_nchld, (now_us() - t0) / 1e3);
+        check(rc == 7, "sigchld n=%d: foreground status survives the storm (%d)", n, rc);
+        check(no_children() && count_fds() == fds, "sigchld n=%d: no zombies or leaked fds", n);
+    }
+    sigaction(SIGCHLD, &old, NULL);
+}
+
+// Pipelines under an fd limit just above what the shell already holds:
+// setup fails cleanly and everything it opened is closed again
+static void stress_fd_limit(void) {
+    char *argv[] = { "/bin/true", NULL };
+    char **seq[17];
+    struct rlimit saved;
+    if (getrlimit(RLIMIT_NOFILE, &saved) < 0) { perror("getrlimit"); return; }
+
+    int fds = count_fds();
+    for (int extra = 0; extra <= 8; extra += 2) {
+        int highest = 0;
+        DIR *d = opendir("/proc/self/fd");
+        for (struct dirent *e; d && (e = readdir(d)) != NULL; )
+            if (atoi(e->d_name) > highest) highest = atoi(e->d_name);
+        if (d) closedir(d);
+
+        struct rlimit lim = { .rlim_cur = (rlim_t)(highest + 1 + extra), .rlim_max = saved.rlim_max };
+        struct cmdline l = make_line(seq, argv, 16, NULL, "/dev/null");
+        double t0 = now_us();
+        setrlimit(RLIMIT_NOFILE, &lim);
+        int rc = execute(&l);
+        setrlimit(RLIMIT_NOFILE, &saved);
+        double t1 = now_us();
+
+        fprintf(g_out, "curve fd-limit spare=%-2d status=%-3d wall=%9.1fms\n", extra, rc, (t1 - t0) / 1e3);
+        check(no_children() && count_fds() == fds, "fd-limit spare=%d: no zombies or leaked fds (%d -> %d)",
+              extra, fds, count_fds());
+    }
+}
+
+static long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+// `seq | tee [-a] FILE | cat`: the in-shell tee takes its tee(2) + splice
+// path, which an O_APPEND file refuses and must fall back from
+static void stress_zcopy(int scale) {
+    char n[16];
+    snprintf(n, sizeof(n), "%d", scale * 10);
+    char trunc_f[] = "/tmp/bench-tee-XXXXXX", append_f[] = "/tmp/bench-tee-XXXXXX";
+    int tfd = mkstemp(trunc_f), afd = mkstemp(append_f);
+    if (tfd < 0 || afd < 0) { perror("mkstemp"); return; }
+    close(tfd);
+    close(afd);
+
+    char *seq_argv[] = { "seq", n, NULL }, *cat_argv[] = { "cat", NULL };
+    char *tee_argv[] = { "tee", trunc_f, NULL }, *tee_a_argv[] = { "tee", "-a", append_f, NULL };
+    char **seq[4];
+    int fds = count_fds();
+
+    struct cmdline l = make_line(seq, cat_argv, 3, NULL, "/dev/null");
+    seq[0] = seq_argv;
+    seq[1] = tee_argv;
+    int rc = execute(&l);
+    long once = file_size(trunc_f);
+    check(rc == 0 && once > 0, "zcopy tee: status %d, %ld bytes written", rc, once);
+
+    seq[1] = tee_a_argv;
+    int rc1 = execute(&l), rc2 = execute(&l);
+    long twice = file_size(append_f);
+    check(rc1 == 0 && rc2 == 0 && twice == 2 * once, "zcopy tee -a: status %d/%d, %ld bytes after two runs (want %ld)",
+          rc1, rc2, twice, 2 * once);
+    check(no_children() && count_fds() == fds, "zcopy: no zombies or leaked fds");
+
+    unlink(trunc_f);
+    unlink(append_f);
+}
+
+static int stress_main(int scale) {
+    g_out = fopen("test_output.txt", "w");
+    if (!g_out) { perror("test_output.txt"); return 1; }
+    snprintf(g_last_cmdline, sizeof(g_last_cmdline), "stress");
+
+    // every launch engine, with external stages (builtins always fork)
+    for (int e = SPAWN_FORK; e <= SPAWN_SERVER; ++e) {
+        g_spawn_engine = (spawn_engine_t)e;
+        stress_bg_jobs(scale);
+        stress_pipelines();
+    }
+    g_spawn_engine = SPAWN_FORK;
+    stress_pipe_fail();
+    stress_sigchld(scale);
+    stress_fd_limit();
+    stress_zcopy(scale);
+    fprintf(g_out, "%s: %d check(s) failed\n", g_failed ? "FAIL" : "PASS", g_failed);
+
+    fclose(g_out);
+    FILE *f = fopen("test_output.txt", "r");
+    if (f) {
+        char line[256];
+        while (fgets(line, sizeof(line), f)) fputs(line, stdout);
+        fclose(f);
+    }
+    return g_failed != 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--stamp") == 0) return stamp_main();
+    if (argc > 1 && strcmp(argv[1], "--stress") == 0) {
+        int scale = argc > 2 ? atoi(argv[2]) : 10000;
+        return stress_main(scale >= 16 ? scale : 16);
+    }
+
+    int iters = argc > 1 ? atoi(argv[1]) : 1000;
+    if (iters < 1) iters = 1;
+
+    g_out = fopen("bench_output.txt", "w");
+    if (!g_out) { perror("bench_output.txt"); return 1; }
+
+    bench_launch(iters);
+    bench_fork_to_exec(iters / 4 > 0 ? iters / 4 : 1);
+    bench_pipeline_setup(iters / 10 > 0 ? iters / 10 : 1);
+    bench_throughput();
+
+    fclose(g_out);
+    // echo the results for interactive runs
+    FILE *f = fopen("bench_output.txt", "r");
+    if (f) {
+        char line[256];
+        while (fgets(line, sizeof(line), f)) fputs(line, stdout);
+        fclose(f);
+    }
+    return 0;
+}
@@ -0,0 +1,326 @@
+#include "builtins.h"
+#include "jobs.h"       // print_jobs()
+#include "options.h"    // builtin_shopt()
+#include "pathcache.h"  // builtin_hash()
+#include "history.h"    // builtin_history()
+#include "trace.h"      // builtin_trace()
+#include "parallel.h"   // builtin_parallel()
+#include "batch.h"      // builtin_source()
+#include "histfile.h"   // histfile_jobs()
+#include "out.h"        // out_printf(), out_flush()
+#include <stdio.h>
+#include <fcntl.h>      // F_DUPFD_CLOEXEC
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+/* ---------- shell builtins ---------- */
+
+static int bi_jobs(char **argv) {
+    if (argv[1] && strcmp(argv[1], "--json") == 0) {
+        print_jobs_json();
+        return 0;
+    }
+    if (argv[1] && strcmp(argv[1], "--all") == 0) {
+        // this shell's (reaps and reports finished ones), then every shell's live jobs
+        print_jobs();
+        if (histfile_jobs() < 0) {
+            fprintf(stderr, "jobs: --all needs a shared file (shopt histfile FILE)\n");
+            return 1;
+        }
+        return 0;
+    }
+    if (argv[1]) {
+        fprintf(stderr, "jobs: usage: jobs [--json | --all]\n");
+        return 2;
+    }
+    print_jobs();
+    return 0;
+}
+
+/* ---------- in-process utilities ---------- */
+
+static int bi_true(char **argv)  { (void)argv; return 0; }
+static int bi_false(char **argv) { (void)argv; return 1; }
+
+static int bi_pwd(char **argv) {
+    (void)argv;
+    char buf[PATH_MAX];
+    if (!getcwd(buf, sizeof(buf))) { perror("pwd"); return 1; }
+    out_puts(buf);
+    return 0;
+}
+
+static int bi_echo(char **argv) {
+    int i = 1, newline = 1;
+    if (argv[1] && strcmp(argv[1], "-n") == 0) { newline = 0; i = 2; }
+    for (int first = 1; argv[i]; ++i, first = 0) {
+        if (!first) out_putc(' ');
+        out_write(argv[i], strlen(argv[i]));
+    }
+    if (newline) out_putc('\n');
+    return 0;
+}
+
+// Backslash escape at *pp (just past the '\'); returns the character
+static int unescape(const char **pp) {
+    char c = *(*pp)++;
+    switch (c) {
+    case 'n':  return '\n';
+    case 't':  return '\t';
+    case 'r':  return '\r';
+    case 'a':  return '\a';
+    case '\\': return '\\';
+    case '\0': (*pp)--; return '\\';
+    default:   return c;
+    }
+}
+
+// %b argument with its backslash escapes processed into out (at least
+// strlen(a)+1 bytes): \0NNN is an octal byte, and \c ends all output, for
+// which 1 is returned
+static int unescape_arg(const char *a, char *out) {
+    while (*a) {
+        if (*a != '\\') { *out++ = *a++; continue; }
+        a++;
+        if (*a == 'c') { *out = '\0'; return 1; }
+        if (*a == '0') {
+            int v = 0;
+            for (int k = 0; k < 3 && a[1] >= '0' && a[1] <= '7'; k++) v = v * 8 + (*++a - '0');
+            a++;
+            *out++ = (char)v;
+            continue;
+        }
+        *out++ = (char)unescape(&a);
+    }
+    *out = '\0';
+    return 0;
+}
+
+// printf FORMAT [ARG]... — %s %b %c %d %i %u %x %o %%; the format is reused
+// until every argument is consumed
+static int bi_printf(char **argv) {
+    if (!argv[1]) { fprintf(stderr, "printf: usage: printf format [arguments]\n"); return 1; }
+    const char *fmt = argv[1];
+    char **arg = &argv[2];
+    int rc = 0;
+
+    do {
+        int consumed = 0;
+        for (const char *p = fmt; *p; ) {
+            if (*p == '\\') { p++; out_putc(unescape(&p)); continue; }
+            if (*p != '%') { out_putc(*p++); continue; }
+
+            // copy a %[flags][width][.prec]conv spec
+            char spec[32];
+            size_t n = 0;
+            spec[n++] = *p++;
+            while (*p && strchr("-+ #0123456789.", *p) && n < sizeof(spec) - 3) spec[n++] = *p++;
+            char conv = *p ? *p++ : '\0';
+            if (conv == '%') { out_putc('%'); continue; }
+
+            const char *a = *arg ? *arg++ : NULL;
+            if (a) consumed = 1;
+            switch (conv) {
+            case 's':
+                spec[n++] = 's'; spec[n] = '\0';
+                out_printf(spec, a ? a : "");
+                break;
+            case 'b': {
+                char *buf = malloc(a ? strlen(a) + 1 : 1);
+                if (!buf) { perror("printf"); return 1; }
+                int stop = unescape_arg(a ? a : "", buf);
+                spec[n++] = 's'; spec[n] = '\0';
+                out_printf(spec, buf);
+                free(buf);
+                if (stop) return rc;
+                break;
+            }
+            case 'c':
+                if (a && *a) out_putc(*a);
+                break;
+            case 'd': case 'i': {
+                char *end;
+                long long v = a ? strtoll(a, &end, 0) : 0;
+                if (a && *end) { fprintf(stderr, "printf: %s: invalid number\n", a); rc = 1; }
+                spec[n++] = 'l'; spec[n++] = 'l'; spec[n++] = conv; spec[n] = '\0';
+                out_printf(spec, v);
+                break;
+            }
+            case 'u': case 'x': case 'X': case 'o': {
+                char *end;
+                unsigned long long v = a ? strtoull(a, &end, 0) : 0;
+                if (a && *end) { fprintf(stderr, "printf: %s: invalid number\n", a); rc = 1; }
+                spec[n++] = 'l'; spec[n++] = 'l'; spec[n++] = conv; spec[n] = '\0';
+                out_printf(spec, v);
+                break;
+            }
+            default:
+                fprintf(stderr, "printf: %%%c: invalid directive\n", conv ? conv : ' ');
+                return 1;
+            }
+        }
+        if (!consumed) break;
+    } while (*arg);
+    return rc;
+}
+
+static int file_test(char op, const char *path) {
+    struct stat st;
+    switch (op) {
+    case 'e': return stat(path, &st) == 0;
+    case 'f': return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+    case 'd': return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+    case 's': return stat(path, &st) == 0 && st.st_size > 0;
+    case 'r': return access(path, R_OK) == 0;
+    case 'w': return access(path, W_OK) == 0;
+    case 'x': return access(path, X_OK) == 0;
+    }
+    return -1;
+}
+
+static int int_arg(const char *s, long long *v) {
+    char *end;
+    errno = 0;
+    *v = strtoll(s, &end, 10);
+    return errno == 0 && end != s && *end == '\0';
+}
+
+// 1 true, 0 false, -1 syntax error
+static int eval_test(int argc, char **a) {
+    if (argc > 0 && strcmp(a[0], "!") == 0) {
+        int r = eval_test(argc - 1, a + 1);
+        return r < 0 ? r : !r;
+    }
+    switch (argc) {
+    case 0: return 0;
+    case 1: return a[0][0] != '\0';
+    case 2:
+        if (strcmp(a[0], "-z") == 0) return a[1][0] == '\0';
+        if (strcmp(a[0], "-n") == 0) return a[1][0] != '\0';
+        if (a[0][0] == '-' && a[0][1] && !a[0][2]) return file_test(a[0][1], a[1]);
+        return -1;
+    case 3: {
+        const char *op = a[1];
+        if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) return strcmp(a[0], a[2]) == 0;
+        if (strcmp(op, "!=") == 0) return strcmp(a[0], a[2]) != 0;
+        long long x, y;
+        if (!int_arg(a[0], &x) || !int_arg(a[2], &y)) return -1;
+        if (strcmp(op, "-eq") == 0) return x == y;
+        if (strcmp(op, "-ne") == 0) return x != y;
+        if (strcmp(op, "-lt") == 0) return x <  y;
+        if (strcmp(op, "-le") == 0) return x <= y;
+        if (strcmp(op, "-gt") == 0) return x >  y;
+        if (strcmp(op, "-ge") == 0) return x >= y;
+        return -1;
+    }
+    }
+    return -1;
+}
+
+// test EXPR / [ EXPR ] — status 0 true, 1 false, 2 error
+static int bi_test(char **argv) {
+    int argc = 0;
+    while (argv[argc]) argc++;
+    if (strcmp(argv[0], "[") == 0) {
+        if (strcmp(argv[argc - 1], "]") != 0) { fprintf(stderr, "[: missing ']'\n"); return 2; }
+        argc--;
+    }
+    int r = eval_test(argc - 1, argv + 1);
+    if (r < 0) { fprintf(stderr, "%s: syntax error\n", argv[0]); return 2; }
+    return !r;
+}
+
+/* ---------- dispatch ---------- */
+
+static const builtin_t g_builtins[] = {
+    { "jobs",     bi_jobs          },
+    { "shopt",    builtin_shopt    },
+    { "hash",     builtin_hash     },
+    { "history",  builtin_history  },
+    { "trace",    builtin_trace    },
+    { "parallel", builtin_parallel },
+    { "source",   builtin_source   },
+    { "echo",     bi_echo          },
+    { "printf",   bi_printf        },
+    { "true",     bi_true          },
+    { "false",    bi_false         },
+    { "test",     bi_test          },
+    { "[",        bi_test          },
+    { "pwd",      bi_pwd           },
+};
+#define NBUILTINS   (sizeof(g_builtins) / sizeof(g_builtins[0]))
+#define BUILTIN_TAB 64          // power of two, > NBUILTINS
+
+static signed char g_slot[BUILTIN_TAB];     // index into g_builtins, -1 = empty
+static unsigned    g_seed;                  // 0 = table not built yet
+
+static unsigned bhash(const char *s, unsigned seed) {
+    unsigned h = seed;
+    while (*s) h = h * 31u + (unsigned char)*s++;
+    return (h ^ (h >> 15)) & (BUILTIN_TAB - 1);
+}
+
+// Pick the first seed under which no two builtin names collide
+static void build_table(void) {
+    for (unsigned seed = 1; seed < 100000; ++seed) {
+        memset(g_slot, -1, sizeof(g_slot));
+        size_t i;
+        for (i = 0; i < NBUILTINS; ++i) {
+            unsigned h = bhash(g_builtins[i].name, seed);
+            if (g_slot[h] >= 0) break;
+            g_slot[h] = (signed char)i;
+        }
+        if (i == NBUILTINS) { g_seed = seed; return; }
+    }
+}
+
+const builtin_t *builtin_find(const char *name) {
+    if (!name) return NULL;
+    if (!g_seed) build_table();
+    int i = g_slot[bhash(name, g_seed)];
+    if (i < 0 || strcmp(g_builtins[i].name, name) != 0) return NULL;
+    return &g_builtins[i];
+}
+
+// Point std fd `target` at fd; returns the saved copy (-1 = untouched)
+static int redirect_std(int target, int fd) {
+    if (fd == target) return -1;
+    // the saved copy must not leak into what the builtin launches
+    int saved = fcntl(target, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+    if (saved < 0 || dup2(fd, target) < 0) {
+        perror("dup2");
+        if (saved >= 0) close(saved);
+        return -2;
+    }
+    return saved;
+}
+
+static void restore_std(int target, int saved) {
+    if (saved < 0) return;
+    dup2(saved, target);
+    close(saved);
+}
+
+int builtin_run(const builtin_t *b, char **argv, int in, int out) {
+    out_flush();
+    fflush(stdout);
+    int saved_in  = redirect_std(STDIN_FILENO, in);
+    int saved_out = redirect_std(STDOUT_FILENO, out);
+    if (saved_in == -2 || saved_out == -2) {
+        restore_std(STDIN_FILENO, saved_in);
+        restore_std(STDOUT_FILENO, saved_out);
+        return 1;
+    }
+
+    int rc = b->fn(argv);
+
+    out_flush();            // the whole listing in one writev()
+    fflush(stdout);
+    restore_std(STDIN_FILENO, saved_in);
+    restore_std(STDOUT_FILENO, saved_out);
+    return rc;
+}
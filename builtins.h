@@ -0,0 +1,18 @@
+#pragma once
+
+// Builtin commands, found through a collision-free hash table built on
+// first use. A builtin writes to stdout/stdin as usual; builtin_run()
+// points those at the requested fds for the duration of the call.
+typedef int (*builtin_fn_t)(char **argv);   // 0 = success
+
+typedef struct {
+    const char   *name;
+    builtin_fn_t  fn;
+} builtin_t;
+
+// Table entry for name, or NULL if it is not a builtin
+const builtin_t *builtin_find(const char *name);
+
+// Run a builtin inside the shell with stdin/stdout on in/out.
+// Does not close in/out. Returns the builtin's status.
+int builtin_run(const builtin_t *b, char **argv, int in, int out);
@@ -0,0 +1,269 @@
+#include "cgroup.h"
+#include "pipebuf.h"    // pipe_size_parse()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+cg_mode_t g_cgroup_mode = CG_OFF;
+
+static int       g_cpu_pct = 0;         // 0 = max
+static long long g_mem_max = 0;         // 0 = max
+static int       g_io_weight = 100;
+
+static int      g_root_fd = -2;         // sh-<pid>; -2 = not set up, -1 = failed
+static unsigned g_next_id;
+static char     g_own[PATH_MAX];        // the cgroup the shell started in
+static int      g_moved;                // shell stepped into sh-<pid>/shell
+
+/* ---------- options ---------- */
+
+static const char *const mode_names[] = { [CG_OFF] = "off", [CG_BG] = "bg", [CG_ALL] = "all" };
+
+int cgroup_set_mode(const char *v) {
+    for (int m = CG_OFF; m <= CG_ALL; ++m)
+        if (strcmp(v, mode_names[m]) == 0) { g_cgroup_mode = (cg_mode_t)m; return 0; }
+    return -1;
+}
+void cgroup_show_mode(char *buf, size_t n) { snprintf(buf, n, "%s", mode_names[g_cgroup_mode]); }
+
+int cgroup_set_cpu(const char *v) {
+    if (strcmp(v, "max") == 0) { g_cpu_pct = 0; return 0; }
+    char *end;
+    long pct = strtol(v, &end, 10);
+    if (end == v || strcmp(end, "%") != 0 || pct <= 0 || pct > 100000) return -1;
+    g_cpu_pct = (int)pct;
+    return 0;
+}
+void cgroup_show_cpu(char *buf, size_t n) {
+    if (g_cpu_pct) snprintf(buf, n, "%d%%", g_cpu_pct);
+    else           snprintf(buf, n, "max");
+}
+
+int cgroup_set_mem(const char *v) {
+    if (strcmp(v, "max") == 0) { g_mem_max = 0; return 0; }
+    size_t sz;
+    if (pipe_size_parse(v, &sz) < 0 || sz == 0) return -1;
+    g_mem_max = (long long)sz;
+    return 0;
+}
+void cgroup_show_mem(char *buf, size_t n) {
+    if (g_mem_max) snprintf(buf, n, "%lld", g_mem_max);
+    else           snprintf(buf, n, "max");
+}
+
+int cgroup_set_io(const char *v) {
+    char *end;
+    long w = strtol(v, &end, 10);
+    if (end == v || *end || w < 1 || w > 10000) return -1;
+    g_io_weight = (int)w;
+    return 0;
+}
+void cgroup_show_io(char *buf, size_t n) { snprintf(buf, n, "%d", g_io_weight); }
+
+/* ---------- hierarchy ---------- */
+
+static int write_at(int dirfd, const char *file, const char *val) {
+    int fd = openat(dirfd, file, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t w = write(fd, val, strlen(val));
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return w < 0 ? -1 : 0;
+}
+
+// Mount point of the v2 hierarchy + our path in it; -1 without one, or
+// with ENAMETOOLONG if our path, or it joined to the mount point, is too long
+static int own_cgroup(char *out, size_t n) {
+    char mnt[PATH_MAX] = "", line[PATH_MAX * 2];
+    FILE *f = fopen("/proc/self/mountinfo", "re");
+    if (!f) return -1;
+    while (fgets(line, sizeof(line), f)) {
+        // id parent maj:min root mountpoint opts... - fstype source superopts
+        char *sep = strstr(line, " - cgroup2 ");
+        char root[PATH_MAX], point[PATH_MAX];
+        if (sep && sscanf(line, "%*s %*s %*s %4095s %4095s", root, point) == 2) {
+            snprintf(mnt, sizeof(mnt), "%s", point);
+            break;
+        }
+    }
+    fclose(f);
+    if (!mnt[0]) return -1;
+
+    char path[PATH_MAX] = "";
+    int len = 0;
+    if (!(f = fopen("/proc/self/cgroup", "re"))) return -1;
+    while (fgets(line, sizeof(line), f))
+        if (strncmp(line, "0::", 3) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            len = snprintf(path, sizeof(path), "%s", line + 3);
+        }
+    fclose(f);
+    if (len < 0 || (size_t)len >= sizeof(path)) { errno = ENAMETOOLONG; return -1; }
+    if (!path[0]) return -1;
+
+    len = snprintf(out, n, "%s%s", mnt, strcmp(path, "/") == 0 ? "" : path);
+    if (len < 0 || (size_t)len >= n) { errno = ENAMETOOLONG; return -1; }
+    return 0;
+}
+
+// Enable every controller on offer below dirfd; returns -1 with errno of
+// the first failure (EBUSY: dirfd has processes of its own)
+static int delegate(int dirfd) {
+    char avail[512] = "";
+    int fd = openat(dirfd, "cgroup.controllers", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t r = read(fd, avail, sizeof(avail) - 1);
+    close(fd);
+    if (r <= 0) return 0;
+    avail[r] = '\0';
+
+    int rc = 0, err = 0;
+    char *save;
+    for (char *c = strtok_r(avail, " \n", &save); c; c = strtok_r(NULL, " \n", &save)) {
+        if (strcmp(c, "cpu") && strcmp(c, "memory") && strcmp(c, "io")) continue;
+        char buf[16];
+        snprintf(buf, sizeof(buf), "+%s", c);
+        if (write_at(dirfd, "cgroup.subtree_control", buf) < 0 && !err) { rc = -1; err = errno; }
+    }
+    errno = err;
+    return rc;
+}
+
+// atexit: step back out and remove sh-<pid>; jobs still running keep it busy
+static void teardown_root(void) {
+    char self[16], name[32];
+    int own_fd = open(g_own, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (own_fd < 0) return;
+    snprintf(self, sizeof(self), "%d", (int)getpid());
+    snprintf(name, sizeof(name), "sh-%d/shell", (int)getpid());
+    if (g_moved && write_at(own_fd, "cgroup.procs", self) == 0)
+        (void)unlinkat(own_fd, name, AT_REMOVEDIR);
+    name[strcspn(name, "/")] = 0;
+    (void)unlinkat(own_fd, name, AT_REMOVEDIR);
+    close(own_fd);
+}
+
+static int setup_root(void) {
+    char *own = g_own, name[32];
+    errno = 0;
+    if (own_cgroup(own, sizeof(g_own)) < 0) {
+        if (errno == ENAMETOOLONG) perror("cgroup");
+        else                       fprintf(stderr, "cgroup: no cgroup v2 hierarchy\n");
+        return -1;
+    }
+    int own_fd = open(own, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (own_fd < 0) { perror(own); return -1; }
+
+    snprintf(name, sizeof(name), "sh-%d", (int)getpid());
+    if (mkdirat(own_fd, name, 0755) < 0 && errno != EEXIST) {
+        perror("cgroup: mkdir");
+        close(own_fd);
+        return -1;
+    }
+    int root = openat(own_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root < 0) { perror("cgroup"); close(own_fd); return -1; }
+
+    if (delegate(own_fd) < 0 && errno == EBUSY) {
+        // our cgroup has processes: step aside into a leaf, then retry
+        char self[16];
+        snprintf(self, sizeof(self), "%d", (int)getpid());
+        if ((mkdirat(root, "shell", 0755) == 0 || errno == EEXIST)) {
+            int leaf = openat(root, "shell", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (leaf >= 0 && write_at(leaf, "cgroup.procs", self) == 0) {
+                g_moved = 1;
+                if (delegate(own_fd) < 0)
+                    fprintf(stderr, "cgroup: %s: controllers not delegated; limits are not enforced\n", own);
+            }
+            if (leaf >= 0) close(leaf);
+        }
+    }
+    (void)delegate(root);
+    close(own_fd);
+    atexit(teardown_root);
+    return root;
+}
+
+/* ---------- per job ---------- */
+
+// Write one limit; a missing controller is reported once per file
+static void limit(int fd, const char *file, const char *val, int *warned) {
+    if (write_at(fd, file, val) < 0 && !*warned) {
+        *warned = 1;
+        fprintf(stderr, "cgroup: %s: %s\n", file, strerror(errno));
+    }
+}
+
+int cg_create(cg_job_t *cg) {
+    cg->fd = -1;
+    if (g_root_fd == -2) g_root_fd = setup_root();
+    if (g_root_fd < 0) return -1;
+
+    static int warned_cpu, warned_mem, warned_io;
+    char name[32], val[64];
+    cg->id = g_next_id++;
+    snprintf(name, sizeof(name), "job-%u", cg->id);
+    if (mkdirat(g_root_fd, name, 0755) < 0 && errno != EEXIST) { perror("cgroup: mkdir"); return -1; }
+    cg->fd = openat(g_root_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cg->fd < 0) { perror("cgroup"); unlinkat(g_root_fd, name, AT_REMOVEDIR); return -1; }
+
+    if (g_cpu_pct) {
+        snprintf(val, sizeof(val), "%d 100000", g_cpu_pct * 1000);
+        limit(cg->fd, "cpu.max", val, &warned_cpu);
+    }
+    if (g_mem_max) {
+        snprintf(val, sizeof(val), "%lld", g_mem_max);
+        limit(cg->fd, "memory.max", val, &warned_mem);
+    }
+    if (g_io_weight != 100) {
+        snprintf(val, sizeof(val), "default %d", g_io_weight);
+        limit(cg->fd, "io.weight", val, &warned_io);
+    }
+    return 0;
+}
+
+// "some avg10=.. avg60=.. avg300=.. total=N"
+static long long psi_some(int dirfd, const char *file) {
+    char buf[256];
+    int fd = openat(dirfd, file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t r = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (r <= 0) return -1;
+    buf[r] = '\0';
+    char *t = strstr(buf, "total=");
+    return t ? atoll(t + 6) : -1;
+}
+
+static long long read_ll(int dirfd, const char *file) {
+    char buf[32];
+    int fd = openat(dirfd, file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t r = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (r <= 0) return -1;
+    buf[r] = '\0';
+    return atoll(buf);
+}
+
+void cg_read_stats(const cg_job_t *cg, cg_stats_t *st) {
+    st->cpu_some_us = psi_some(cg->fd, "cpu.pressure");
+    st->mem_some_us = psi_some(cg->fd, "memory.pressure");
+    st->io_some_us  = psi_some(cg->fd, "io.pressure");
+    st->mem_peak    = read_ll(cg->fd, "memory.peak");
+}
+
+void cg_destroy(cg_job_t *cg) {
+    if (cg->fd < 0) return;
+    char name[32];
+    snprintf(name, sizeof(name), "job-%u", cg->id);
+    close(cg->fd);
+    cg->fd = -1;
+    // EBUSY: something escaped the job and still runs in it; leave it be
+    (void)unlinkat(g_root_fd, name, AT_REMOVEDIR);
+}
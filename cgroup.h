@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+
+// cgroup v2 placement of jobs (`shopt cgroup off | bg | all`). Every job
+// (bg) or every line (all) gets a child cgroup under sh-<pid>, beside the
+// shell's own, with the limits from `shopt cgcpu` / `cgmem` / `cgio`.
+// Children are started inside it with clone3(CLONE_INTO_CGROUP), or move
+// themselves there before exec. If the shell's cgroup has other processes
+// the shell first moves itself to sh-<pid>/shell so controllers can be
+// delegated (the cgroup v2 "no internal processes" rule).
+typedef enum { CG_OFF = 0, CG_BG, CG_ALL } cg_mode_t;
+
+extern cg_mode_t g_cgroup_mode;
+
+int  cgroup_set_mode(const char *v);
+void cgroup_show_mode(char *buf, size_t n);
+int  cgroup_set_cpu(const char *v);     // max | N%  (of one CPU)
+void cgroup_show_cpu(char *buf, size_t n);
+int  cgroup_set_mem(const char *v);     // max | bytes[k|M|G]
+void cgroup_show_mem(char *buf, size_t n);
+int  cgroup_set_io(const char *v);      // 1..10000 (default 100)
+void cgroup_show_io(char *buf, size_t n);
+
+// A job's cgroup
+typedef struct {
+    int      fd;        // directory fd, -1 = none
+    unsigned id;        // directory is sh-<pid>/job-<id>
+} cg_job_t;
+
+// Pressure stall totals (the "some" line, in microseconds) and memory use
+typedef struct {
+    long long cpu_some_us, mem_some_us, io_some_us;
+    long long mem_peak;     // bytes; -1 without the memory controller
+} cg_stats_t;
+
+// New cgroup with the current limits. Returns 0, or -1 (cg->fd = -1;
+// warnings printed once).
+int  cg_create(cg_job_t *cg);
+void cg_read_stats(const cg_job_t *cg, cg_stats_t *st);
+// Remove an emptied cgroup and close its fd
+void cg_destroy(cg_job_t *cg);
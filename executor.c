@@ -1,14 +1,204 @@
+#define _GNU_SOURCE     // pipe2
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <sys/wait.h>   // waitpid
+#include <sys/wait.h>   // wait4
+#include <sys/resource.h>
+#include <time.h>       // clock_gettime
 #include <fcntl.h>      // open flags
 #include <string.h>     // strcmp
 #include <errno.h>
+#include <signal.h>     // kill
+#include <ctype.h>      // isalnum
+#include <poll.h>
+#include <sys/syscall.h>  // SYS_pidfd_open
 
 #include "parser.h"
 #include "jobs.h"       // add_job(), print_jobs(), reap_finished_jobs()
 #include "shell.h"      // extern char g_last_cmdline[256]
+#include "launcher.h"   // spawn_process(), g_spawn_engine
+#include "zcopy.h"      // zc_classify(), zc_main()
+#include "history.h"    // history_add()
+#include "executor.h"
+#include "trace.h"      // TRACE_DECL(), TRACE_SPAN()
+#include "builtins.h"   // builtin_find(), builtin_run()
+#include "batch.h"      // g_batch_mode
+#include "arena.h"
+#include "pipebuf.h"    // pipe_open(), g_pipe_size
+#include "affinity.h"   // affinity_stage_cpu()
+#include "redircache.h" // redir_open()
+#include "uring.h"      // uring_wait_children(), uring_open_batch()
+#include "memo.h"       // `cached` prefix
+#include "jobevents.h"  // job_events_flush()
+#include "cgroup.h"     // cg_create()
+#include "plan.h"       // plan_get()
+#include "remote.h"     // `@host` stages
+
+// Per-shell execution context: pipeline bookkeeping (pid arrays and the
+// like) is bump-allocated here and rolled back after each line, so the
+// steady state makes no heap calls. Nested execute() calls (source) roll
+// back only their own allocations.
+static arena_t g_exec_arena = ARENA_INIT;
+
+// cgroup the children of the current line start in (fd -1: none); a
+// background job takes it over, otherwise it is removed after the line
+static cg_job_t g_line_cg = { .fd = -1 };
+
+// Resource usage of foreground children since the last `time` prefix
+static struct rusage g_fg_rusage;
+
+int  g_last_status = EXIT_SUCCESS;
+int *g_pipestatus  = NULL;
+int  g_npipestatus = 0;
+static int g_pipestatus_cap = 0;
+
+// Shell convention: the exit code, or 128+N for death by signal N
+static int exit_code(int status) {
+    if (WIFEXITED(status))   return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return EXIT_FAILURE;
+}
+
+// Status of a command that could not be started: 127 if it was not found
+static int launch_failure(void) {
+    return errno == ENOENT ? 127 : EXIT_FAILURE;
+}
+
+// Wait for a foreground child, folding its rusage into g_fg_rusage.
+// Returns its exit code (see exit_code()). Blocking fallback for fg_poll().
+static int fg_wait(pid_t pid) {
+    int status;
+    struct rusage ru;
+    TRACE_DECL(t_wait);
+    while (wait4(pid, &status, 0, &ru) < 0) {
+        if (errno != EINTR) return EXIT_FAILURE;
+    }
+    TRACE_SPAN("wait", t_wait);
+    rusage_add(&g_fg_rusage, &ru);
+    return exit_code(status);
+}
+
+/**
+ * @brief Waits for foreground children while reaping background jobs
+ *        One poll() covers a pidfd per foreground child and the job
+ *        table's epoll fd, so jobs that end during a long foreground
+ *        command leave g_jobs (and the process table) right away.
+ * @return 0 once every child is reaped, -1 if pidfds are unavailable
+ *         (nothing reaped)
+ */
+static int fg_poll(const pid_t *pids, int n, int *st) {
+    struct pollfd *pfd = arena_alloc(&g_exec_arena, sizeof(*pfd) * (size_t)(n + 1));
+    int           *who = arena_alloc(&g_exec_arena, sizeof(int) * (size_t)n);
+    if (!pfd || !who) return -1;
+
+    int nfg = 0;
+    for (int i = 0; i < n; i++) {
+        if (pids[i] <= 0) continue;
+        int fd = (int)syscall(SYS_pidfd_open, pids[i], 0);
+        if (fd < 0) {
+            while (nfg > 0) close(pfd[--nfg].fd);
+            return -1;
+        }
+        pfd[nfg] = (struct pollfd){ .fd = fd, .events = POLLIN };
+        who[nfg++] = i;
+    }
+
+    TRACE_DECL(t_wait);
+    int left = nfg;
+    while (left > 0) {
+        // the epoll set appears with the first background job
+        int njobs = g_jobs.epfd >= 0 && g_jobs.nactive > 0;
+        pfd[nfg] = (struct pollfd){ .fd = njobs ? g_jobs.epfd : -1, .events = POLLIN };
+        // stages without a pidfd can only be polled
+        int r = poll(pfd, (nfds_t)nfg + 1, g_jobs.npolled > 0 ? 100 : -1);
+        if (r < 0 && errno != EINTR) break;
+        if (r == 0 || (r > 0 && pfd[nfg].revents)) reap_finished_jobs();
+
+        for (int k = 0; r > 0 && k < nfg; k++) {
+            if (pfd[k].fd < 0 || !pfd[k].revents) continue;
+            int status;
+            struct rusage ru;
+            pid_t got = wait4(pids[who[k]], &status, WNOHANG, &ru);
+            if (got == 0) continue;
+            st[who[k]] = got == pids[who[k]] ? exit_code(status) : EXIT_FAILURE;
+            if (got > 0) rusage_add(&g_fg_rusage, &ru);
+            close(pfd[k].fd);
+            pfd[k].fd = -1;     // poll() skips negative fds
+            left--;
+        }
+    }
+    TRACE_SPAN("wait", t_wait);
+
+    // poll() failed: finish the rest with blocking waits
+    for (int k = 0; k < nfg; k++) {
+        if (pfd[k].fd < 0) continue;
+        close(pfd[k].fd);
+        st[who[k]] = fg_wait(pids[who[k]]);
+    }
+    return 0;
+}
+
+// Wait for the forked stages of a foreground pipeline (pids[i] > 0),
+// storing exit codes in st. With `shopt wait uring` they are reaped by one
+// batched submission that also watches the job table's epoll fd, and
+// their rusage is the RUSAGE_CHILDREN delta less the background stages
+// reaped meanwhile. That delta has no per-process maxrss, so `time`
+// shows it as n/a.
+static void fg_wait_all(const pid_t *pids, int n, int *st) {
+    pid_t *live = g_wait_uring ? arena_alloc(&g_exec_arena, sizeof(pid_t) * (size_t)n) : NULL;
+    int   *ws   = live ? arena_alloc(&g_exec_arena, sizeof(int) * (size_t)n) : NULL;
+    int    nlive = 0;
+    if (ws) {
+        for (int i = 0; i < n; i++) if (pids[i] > 0) live[nlive++] = pids[i];
+
+        struct rusage before, after, jobs_before = g_jobs.reaped_ru;
+        getrusage(RUSAGE_CHILDREN, &before);
+        TRACE_DECL(t_wait);
+        if (uring_wait_children(live, nlive, ws, g_jobs.epfd, reap_finished_jobs) == 0) {
+            TRACE_SPAN("wait", t_wait);
+            getrusage(RUSAGE_CHILDREN, &after);
+            rusage_delta(&after, &before);
+            struct rusage jobs = g_jobs.reaped_ru;
+            rusage_delta(&jobs, &jobs_before);
+            rusage_delta(&after, &jobs);
+            after.ru_maxrss = -1;
+            rusage_add(&g_fg_rusage, &after);
+            for (int i = 0, k = 0; i < n; i++) if (pids[i] > 0) st[i] = exit_code(ws[k++]);
+            return;
+        }
+    }
+    if (fg_poll(pids, n, st) == 0) return;
+    for (int i = 0; i < n; i++) if (pids[i] > 0) st[i] = fg_wait(pids[i]);
+}
+
+/**
+ * @brief Starts a single, simple command without waiting for it
+ *        (launched through the engine selected by `shopt spawn`)
+ * @param cmd   program name (argv[0])
+ * @param args  argv vector (NULL-terminated)
+ * @param in    fd to use as STDIN (or STDIN_FILENO); closed by the call
+ * @param out   fd to use as STDOUT (or STDOUT_FILENO); closed by the call
+ * @param pgrp  put the child in a process group of its own if non-zero
+ * @return child pid, or -1 on failure (message already printed)
+ */
+pid_t launch_command(char* cmd, char** args, int in, int out, int pgrp) {
+    spawn_req_t req = { .file = cmd, .argv = args, .in = in, .out = out, .setpgrp = pgrp,
+                        .barrier_fd = -1, .cgroup_fd = g_line_cg.fd };
+    pid_t pid = spawn_process(&req);
+
+    if (in  != STDIN_FILENO)  close(in);
+    if (out != STDOUT_FILENO) close(out);
+    return pid;
+}
+
+// Register a background job (and its cgroup, if the line has one)
+static void track_job(pid_t pgid, const pid_t *pids, int npids) {
+    int idx = add_job(pgid, pids, npids, g_last_cmdline);
+    if (idx >= 0 && g_line_cg.fd >= 0) {
+        job_attach_cgroup(idx, g_line_cg);
+        g_line_cg.fd = -1;
+    }
+}
 
 /**
  * @brief Executes a single, simple command in another process
@@ -17,224 +207,513 @@
  * @param in    fd to use as STDIN (or STDIN_FILENO)
  * @param out   fd to use as STDOUT (or STDOUT_FILENO)
  * @param bg    run in background if non-zero
+ * @return the command's exit status (0 once a background job is started,
+ *         127 if the command was not found)
  */
 int execute_command(char* cmd, char** args, int in, int out, int bg) {
     if (!cmd || !args || !args[0]) return EXIT_SUCCESS;
 
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("fork");
-        if (in  != STDIN_FILENO)  close(in);
-        if (out != STDOUT_FILENO) close(out);
-        return EXIT_FAILURE;
-    }
-
-    if (pid == 0) {
-        if (in  != STDIN_FILENO)  {
-            if (dup2(in,  STDIN_FILENO)  < 0) { perror("dup2 in");  _exit(126); }
-            close(in);
-        }
-        if (out != STDOUT_FILENO) {
-            if (dup2(out, STDOUT_FILENO) < 0) { perror("dup2 out"); _exit(126); }
-            close(out);
-        }
-        execvp(cmd, args);
-        perror("execvp");
-        _exit(127);
-    }
-
-    if (in  != STDIN_FILENO)  close(in);
-    if (out != STDOUT_FILENO) close(out);
+    // background jobs get their own process group; see add_job()
+    pid_t pid = launch_command(cmd, args, in, out, bg);
+    if (pid < 0) return launch_failure();
 
     if (!bg) {
-        int status;
-        (void)waitpid(pid, &status, 0);
-    } else {
-        add_job(pid, g_last_cmdline);
+        int st = EXIT_FAILURE;
+        fg_wait_all(&pid, 1, &st);
+        return st;
     }
 
+    track_job(pid, &pid, 1);
     return EXIT_SUCCESS;
 }
 
+static int execute_timed(struct cmdline *l, unsigned flags, char **literal);
+static int execute_line(struct cmdline *l, unsigned flags, char **literal);
+
 /**
  * @brief Executes a command line (simple or pipeline)
  * @param l parsed command line
- * @return 0 on success, non-zero on error
+ * @return the exit status of the line (also left in g_last_status)
  */
 int execute(struct cmdline *l) {
     if (!l) return EXIT_SUCCESS;
 
+    cmdlist_t one = { .line = l, .op = SEQ_END, .flags = 0, .literal = NULL, .next = NULL };
+    return execute_list(&one);
+}
+
+/**
+ * @brief Executes a `;` / `&&` / `||` list from one input line
+ *        Skipped commands leave the status of the last one that ran, so
+ *        `a && b || c` runs c when either a or b fails. No process is
+ *        created for the operators themselves.
+ * @param list commands in input order
+ * @return the exit status of the last command run
+ */
+int execute_list(cmdlist_t *list) {
     reap_finished_jobs();
+    if (!g_batch_mode) history_add(g_last_cmdline);
+
+    int rc = g_last_status;
+    seq_op_t op = SEQ_ALWAYS;
+    for (cmdlist_t *c = list; c; op = c->op, c = c->next) {
+        if (op == SEQ_AND && rc != EXIT_SUCCESS) continue;
+        if (op == SEQ_OR  && rc == EXIT_SUCCESS) continue;
+        rc = c->line ? execute_timed(c->line, c->flags, c->literal) : EXIT_SUCCESS;
+    }
+    job_events_flush();     // starts of the line's background jobs
+    return rc;
+}
 
+/**
+ * @brief Runs one command of a list
+ *        A leading `time` word reports the rusage of the foreground children.
+ */
+static int execute_timed(struct cmdline *l, unsigned flags, char **literal) {
+    char **first = l->seq ? l->seq[0] : NULL;
+    if (!first || !first[0] || strcmp(first[0], "time") != 0) return execute_line(l, flags, literal);
+
+    struct timespec t0, t1;
+    memset(&g_fg_rusage, 0, sizeof(g_fg_rusage));
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    l->seq[0] = first + 1;
+    int rc = execute_line(l, flags, literal);
+    l->seq[0] = first;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    print_rusage(stderr, &g_fg_rusage,
+                 (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9);
+    return rc;
+}
+
+// $?, $PIPESTATUS (stage 0), ${PIPESTATUS[n]} and ${PIPESTATUS[@]}
+static char *expand_word(char *w) {
+    size_t len = strlen(w), ndollar = 0;
+    for (const char *p = w; *p; p++) ndollar += *p == '$';
+    if (ndollar == 0) return w;
+
+    // every status is at most 3 digits and a separator
+    size_t cap = len * 2 + ndollar * 4 * (size_t)g_npipestatus + 1;
+    char *out = arena_alloc(&g_exec_arena, cap), *o = out;
+    if (!out) return w;
+
+    for (const char *p = w; *p; ) {
+        if (p[0] == '$' && p[1] == '?') {
+            o += sprintf(o, "%d", g_last_status);
+            p += 2;
+            continue;
+        }
+        if (p[0] == '$' && strncmp(p + 1, "PIPESTATUS", 10) == 0 &&
+            p[11] != '_' && !isalnum((unsigned char)p[11])) {
+            o += sprintf(o, "%d", g_npipestatus ? g_pipestatus[0] : g_last_status);
+            p += 11;
+            continue;
+        }
+        if (p[0] == '$' && strncmp(p + 1, "{PIPESTATUS[", 12) == 0) {
+            const char *q = p + 13;
+            if (strncmp(q, "@]}", 3) == 0) {
+                for (int i = 0; i < g_npipestatus; i++)
+                    o += sprintf(o, i ? " %d" : "%d", g_pipestatus[i]);
+                p = q + 3;
+                continue;
+            }
+            char *e;
+            long n = strtol(q, &e, 10);
+            if (e != q && e[0] == ']' && e[1] == '}') {
+                if (n >= 0 && n < g_npipestatus) o += sprintf(o, "%d", g_pipestatus[n]);
+                p = e + 2;
+                continue;
+            }
+        }
+        *o++ = *p++;
+    }
+    *o = '\0';
+    return out;
+}
+
+static int is_literal(char **literal, const char *w) {
+    for (; literal && *literal; literal++)
+        if (*literal == w) return 1;
+    return 0;
+}
+
+// Arena copy of l with status variables expanded; l itself if no word
+// asks for one. Words in literal (see cmdlist_t) are kept as they are.
+static struct cmdline *expand_line(struct cmdline *l, char **literal) {
+    int nstages = 0, dollar = 0;
+    for (; l->seq[nstages]; nstages++)
+        for (char **w = l->seq[nstages]; *w && !dollar; w++)
+            dollar = strchr(*w, '$') != NULL && !is_literal(literal, *w);
+    if (!dollar) return l;
+
+    struct cmdline *x = arena_alloc(&g_exec_arena, sizeof(*x));
+    char ***seq = arena_alloc(&g_exec_arena, sizeof(char **) * (size_t)(nstages + 1));
+    if (!x || !seq) return l;
+    *x = *l;
+    x->seq = seq;
+    for (int i = 0; i < nstages; i++) {
+        int nw = 0;
+        while (l->seq[i][nw]) nw++;
+        seq[i] = arena_alloc(&g_exec_arena, sizeof(char *) * (size_t)(nw + 1));
+        if (!seq[i]) return l;
+        for (int k = 0; k < nw; k++) {
+            char *w = l->seq[i][k];
+            seq[i][k] = is_literal(literal, w) ? w : expand_word(w);
+        }
+        seq[i][nw] = NULL;
+    }
+    seq[nstages] = NULL;
+    return x;
+}
+
+// Arena copy of l with `@host cmd` stages turned into ssh launches (see
+// remote.h); l itself if it has none, NULL after an error was reported
+static struct cmdline *remote_line(struct cmdline *l) {
+    int nstages = 0, remote = 0;
+    for (; l->seq[nstages]; nstages++) remote |= remote_is_stage(l->seq[nstages]);
+    if (!remote) return l;
+
+    struct cmdline *x = arena_alloc(&g_exec_arena, sizeof(*x));
+    char ***seq = arena_alloc(&g_exec_arena, sizeof(char **) * (size_t)(nstages + 1));
+    if (!x || !seq) {
+        fprintf(stderr, "remote: %s\n", strerror(ENOMEM));
+        return NULL;
+    }
+    *x = *l;
+    x->seq = seq;
+    for (int i = 0; i < nstages; i++) {
+        seq[i] = l->seq[i];
+        if (remote_is_stage(seq[i]) && !(seq[i] = remote_argv(&g_exec_arena, l->seq[i]))) return NULL;
+    }
+    seq[nstages] = NULL;
+    return x;
+}
+
+// Publish one line's per-stage statuses as PIPESTATUS (the array only grows)
+static void set_pipestatus(const int *st, int n) {
+    if (n > g_pipestatus_cap) {
+        int *np = realloc(g_pipestatus, sizeof(int) * (size_t)n);
+        if (!np) { perror("PIPESTATUS"); return; }
+        g_pipestatus = np;
+        g_pipestatus_cap = n;
+    }
+    memcpy(g_pipestatus, st, sizeof(int) * (size_t)n);
+    g_npipestatus = n;
+}
+
+// Per-line settings that struct cmdline has no room for
+typedef struct {
+    size_t pipesz;      // size for the pipes between stages (0 = kernel default)
+    int    append;      // open l->out with O_APPEND (`>>`)
+    int    cached;      // `cached` prefix: memoize a simple command
+} line_opts_t;
+
+static int execute_stages(struct cmdline *l, int *st, const line_opts_t *o);
+
+/**
+ * @brief Runs one parsed line once the per-line bookkeeping is done
+ *        and records its status in g_last_status / PIPESTATUS
+ *        A leading `pipesz=SIZE` word overrides `shopt pipesz` for the line;
+ *        a leading `cached` word replays a memoized result (see memo.h);
+ *        stages written `@host cmd` run on host (see remote.h).
+ */
+static int execute_line(struct cmdline *l, unsigned flags, char **literal) {
+    arena_mark_t m = arena_mark(&g_exec_arena);
+
+    line_opts_t o = { .pipesz = g_pipe_size, .append = (flags & CMD_APPEND) != 0 };
+    char **first = l->seq[0];
+    if (first && first[0] && strncmp(first[0], "pipesz=", 7) == 0) {
+        if (pipe_size_parse(first[0] + 7, &o.pipesz) < 0) {
+            fprintf(stderr, "%s: invalid pipe size\n", first[0]);
+            arena_release(&g_exec_arena, m);
+            return g_last_status = EXIT_FAILURE;
+        }
+        l->seq[0]++;
+    }
+    if (l->seq[0] && l->seq[0][0] && strcmp(l->seq[0][0], "cached") == 0) {
+        o.cached = 1;
+        l->seq[0]++;
+    }
+    struct cmdline *x = remote_line(expand_line(l, literal));
+    if (!x) {
+        l->seq[0] = first;
+        arena_release(&g_exec_arena, m);
+        return g_last_status = EXIT_FAILURE;
+    }
+    int ncmds = 0;
+    while (x->seq[ncmds] != NULL) ncmds++;
+    int *st = arena_alloc(&g_exec_arena, sizeof(int) * (size_t)(ncmds ? ncmds : 1));
+
+    int rc = EXIT_FAILURE;
+    if (!st) {
+        fprintf(stderr, "PIPESTATUS: %s\n", strerror(ENOMEM));
+    } else {
+        memset(st, 0, sizeof(int) * (size_t)(ncmds ? ncmds : 1));
+        // `source` runs nested lines: each gets its own cgroup
+        cg_job_t outer = g_line_cg;
+        g_line_cg.fd = -1;
+        if (g_cgroup_mode == CG_ALL || (g_cgroup_mode == CG_BG && x->bg)) (void)cg_create(&g_line_cg);
+        rc = execute_stages(x, st, &o);
+        cg_destroy(&g_line_cg);     // no-op once a job took it
+        g_line_cg = outer;
+        if (ncmds <= 1) st[0] = rc;
+        set_pipestatus(st, ncmds ? ncmds : 1);
+    }
+    g_last_status = rc;
+    l->seq[0] = first;
+
+    arena_release(&g_exec_arena, m);
+    return rc;
+}
+
+/**
+ * @brief Opens l->in / l->out for a line
+ *        Foreground lines go through the fd cache (a background job may
+ *        still be using the offset a cached fd shares); other opens are
+ *        submitted together when `shopt wait uring` is on.
+ * @return 0, or -1 after reporting the failing path (nothing left open)
+ */
+static int open_redirs(struct cmdline *l, const line_opts_t *o, int *in, int *out) {
+    const char  *paths[2];
+    redir_mode_t modes[2];
+    int         *dst[2], fds[2], n = 0;
+    if (l->in)  { paths[n] = l->in;  modes[n] = REDIR_IN;  dst[n++] = in; }
+    if (l->out) { paths[n] = l->out; modes[n] = o->append ? REDIR_APPEND : REDIR_TRUNC; dst[n++] = out; }
+    if (n == 0) return 0;
+
+    TRACE_DECL(t_open);
+    int batched = 0;
+    if (g_wait_uring && (l->bg || !g_redir_cache)) {
+        int flags[2] = { redir_flags(modes[0]), n > 1 ? redir_flags(modes[1]) : 0 };
+        batched = uring_open_batch(paths, flags, n, fds) == 0;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (batched && fds[i] != -ECANCELED) {
+            if (fds[i] < 0) { errno = -fds[i]; fds[i] = -1; }
+        } else if (l->bg) {
+            fds[i] = open(paths[i], redir_flags(modes[i]), 0644);
+        } else {
+            fds[i] = redir_open(paths[i], modes[i]);
+        }
+        if (fds[i] < 0) { n = i + 1; break; }   // `<` fails before `>` creates
+    }
+    TRACE_SPAN("open", t_open);
+
+    for (int i = 0; i < n; ++i) {
+        if (fds[i] >= 0) continue;
+        int saved = errno;
+        for (int k = 0; k < n; ++k) if (fds[k] >= 0) close(fds[k]);
+        errno = saved;
+        perror(paths[i]);
+        return -1;
+    }
+    for (int i = 0; i < n; ++i) *dst[i] = fds[i];
+    return 0;
+}
+
+/**
+ * @brief Runs a simple command through the memo cache
+ *        A hit writes the stored stdout without forking; a miss runs the
+ *        command into a cache file and then copies that to out.
+ */
+static int execute_cached(struct cmdline *l, char **argv, int in, int out) {
+    memo_key_t k;
+    int rc, rec = -1;
+    if (memo_key(&k, argv, l->in) == 0) {
+        if (memo_replay(&k, out, &rc)) {
+            if (in  != STDIN_FILENO)  close(in);
+            if (out != STDOUT_FILENO) close(out);
+            return rc;
+        }
+        rec = memo_begin();
+    }
+    if (rec < 0) return execute_command(argv[0], argv, in, out, 0);
+
+    int child_out = fcntl(rec, F_DUPFD_CLOEXEC, 0);
+    if (child_out < 0) { close(rec); return execute_command(argv[0], argv, in, out, 0); }
+    rc = execute_command(argv[0], argv, in, child_out, 0);
+    memo_finish(&k, rec, rc, out);
+    if (out != STDOUT_FILENO) close(out);
+    return rc;
+}
+
+/**
+ * @brief Builtins, single commands and N-stage pipelines
+ * @param st per-stage exit statuses of a foreground pipeline (left 0 for
+ *           background stages); the caller fills it for single commands
+ * @param o  pipe size and redirection mode for the line
+ * @return the status of the line: the last stage's for a pipeline
+ */
+static int execute_stages(struct cmdline *l, int *st, const line_opts_t *o) {
     // Count commands in the pipeline
     int ncmds = 0;
     while (l->seq[ncmds] != NULL) ncmds++;
     if (ncmds == 0) return EXIT_SUCCESS;
 
-    // Single-command path (unchanged)
+    // Single-command path
     if (ncmds == 1) {
         char **argv = l->seq[0];
         if (argv == NULL || argv[0] == NULL) return EXIT_SUCCESS;
 
-        // Builtin: jobs
-        if (strcmp(argv[0], "jobs") == 0) {
-            print_jobs();
-            return EXIT_SUCCESS;
-        }
-
         int in_fd  = STDIN_FILENO;
         int out_fd = STDOUT_FILENO;
 
-        if (l->in) {
-            in_fd = open(l->in, O_RDONLY);
-            if (in_fd < 0) { perror(l->in); return EXIT_FAILURE; }
+        if (open_redirs(l, o, &in_fd, &out_fd) < 0) return EXIT_FAILURE;
+
+        const builtin_t *bi = builtin_find(argv[0]);
+        if (bi && l->bg) {
+            // background builtin: a forked copy of the shell runs it as a job
+            spawn_req_t req = { .file = argv[0], .argv = argv, .in = in_fd, .out = out_fd,
+                                .barrier_fd = -1, .setpgrp = 1, .builtin = bi->fn,
+                                .cgroup_fd = g_line_cg.fd };
+            pid_t pid = spawn_process(&req);
+            if (in_fd  != STDIN_FILENO)  close(in_fd);
+            if (out_fd != STDOUT_FILENO) close(out_fd);
+            if (pid < 0) return launch_failure();
+            track_job(pid, &pid, 1);
+            return EXIT_SUCCESS;
         }
-        if (l->out) {
-            out_fd = open(l->out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-            if (out_fd < 0) {
-                perror(l->out);
-                if (in_fd != STDIN_FILENO) close(in_fd);
-                return EXIT_FAILURE;
-            }
+        if (bi) {
+            int rc = builtin_run(bi, argv, in_fd, out_fd);
+            if (in_fd  != STDIN_FILENO)  close(in_fd);
+            if (out_fd != STDOUT_FILENO) close(out_fd);
+            return rc & 0xff;
         }
 
+        // cat/tee: a forked copy of the shell moves the bytes in-kernel,
+        // no exec (forked, so ^C and the job's group reach it)
+        if (zc_classify(argv) != ZC_NONE) {
+            spawn_req_t req = { .file = argv[0], .argv = argv, .in = in_fd, .out = out_fd,
+                                .barrier_fd = -1, .setpgrp = l->bg, .builtin = zc_main,
+                                .cgroup_fd = g_line_cg.fd };
+            pid_t pid = spawn_process(&req);
+            if (in_fd  != STDIN_FILENO)  close(in_fd);
+            if (out_fd != STDOUT_FILENO) close(out_fd);
+            if (pid < 0) return launch_failure();
+            if (l->bg) { track_job(pid, &pid, 1); return EXIT_SUCCESS; }
+            int rc = EXIT_FAILURE;
+            fg_wait_all(&pid, 1, &rc);
+            return rc;
+        }
+
+        if (o->cached && !l->bg) return execute_cached(l, argv, in_fd, out_fd);
+
         return execute_command(argv[0], argv, in_fd, out_fd, l->bg ? 1 : 0);
     }
 
     /* ---------- N-stage pipeline (ncmds >= 2) ---------- */
 
-    const int npipes = ncmds - 1;
-    int (*pipes)[2] = NULL;
-    if (npipes > 0) {
-        pipes = malloc(sizeof(int[2]) * npipes);
-        if (!pipes) { fprintf(stderr, "malloc pipes: %s\n", strerror(errno)); return EXIT_FAILURE; }
-    }
-
-    // Create all pipes
-    for (int i = 0; i < npipes; i++) {
-        if (pipe(pipes[i]) < 0) {
-            perror("pipe");
-            for (int k = 0; k < i; k++) { close(pipes[k][0]); close(pipes[k][1]); }
-            free(pipes);
-            return EXIT_FAILURE;
-        }
-    }
+    if (o->cached) fprintf(stderr, "cached: pipelines are not memoized\n");
 
     // Redirection endpoints (opened once)
     int in_fd_first  = STDIN_FILENO;
     int out_fd_last  = STDOUT_FILENO;
 
-    if (l->in) {
-        in_fd_first = open(l->in, O_RDONLY);
-        if (in_fd_first < 0) {
-            perror(l->in);
-            for (int k = 0; k < npipes; k++) { close(pipes[k][0]); close(pipes[k][1]); }
-            free(pipes);
-            return EXIT_FAILURE;
-        }
-    }
-    if (l->out) {
-        out_fd_last = open(l->out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (out_fd_last < 0) {
-            perror(l->out);
-            if (in_fd_first != STDIN_FILENO) close(in_fd_first);
-            for (int k = 0; k < npipes; k++) { close(pipes[k][0]); close(pipes[k][1]); }
-            free(pipes);
-            return EXIT_FAILURE;
-        }
-    }
+    if (open_redirs(l, o, &in_fd_first, &out_fd_last) < 0) return EXIT_FAILURE;
 
-    pid_t *pids = malloc(sizeof(pid_t) * ncmds);
+    pid_t *pids = arena_alloc(&g_exec_arena, sizeof(pid_t) * (size_t)ncmds);
     if (!pids) {
-        fprintf(stderr, "malloc pids: %s\n", strerror(errno));
+        fprintf(stderr, "pids: %s\n", strerror(ENOMEM));
         if (in_fd_first  != STDIN_FILENO)  close(in_fd_first);
         if (out_fd_last  != STDOUT_FILENO) close(out_fd_last);
-        for (int k = 0; k < npipes; k++) { close(pipes[k][0]); close(pipes[k][1]); }
-        free(pipes);
         return EXIT_FAILURE;
     }
+    memset(pids, 0, sizeof(pid_t) * (size_t)ncmds);   // PIPE_FAIL reaps only forked stages
+
+    // builtins and binaries of this pipeline shape, resolved on first run
+    const plan_t *plan = plan_get(l->seq, ncmds);
+
+    // Optional launch barrier: every stage blocks until the write end closes
+    int barrier[2] = { -1, -1 };
+    if (g_pipeline_barrier && pipe2(barrier, O_CLOEXEC) < 0) {
+        perror("pipe barrier");
+        barrier[0] = barrier[1] = -1;
+    }
+
+    // Pipes are created one stage ahead, so the parent holds at most one
+    // pipe at a time and each child only ever sees its own two ends.
+    int prev_rd = in_fd_first;      // stdin of the next stage
 
     for (int i = 0; i < ncmds; i++) {
         char **argv = l->seq[i];
         if (!argv || !argv[0]) {
             fprintf(stderr, "empty command in pipeline at stage %d\n", i);
+            errno = EINVAL;
             goto PIPE_FAIL;
         }
 
-        pid_t pid = fork();
-        if (pid < 0) {
-            perror("fork");
-            goto PIPE_FAIL;
-        }
-
-        if (pid == 0) {
-            // Child: choose fds
-            int in_fd  = (i == 0)           ? in_fd_first      : pipes[i-1][0];
-            int out_fd = (i == ncmds - 1)   ? out_fd_last      : pipes[i][1];
-
-            // Wire stdin/stdout
-            if (in_fd != STDIN_FILENO)  { if (dup2(in_fd,  STDIN_FILENO)  < 0) { perror("dup2 in");  _exit(126); } }
-            if (out_fd != STDOUT_FILENO){ if (dup2(out_fd, STDOUT_FILENO) < 0) { perror("dup2 out"); _exit(126); } }
-
-            // Close all pipe fds in child
-            for (int k = 0; k < npipes; k++) {
-                close(pipes[k][0]);
-                close(pipes[k][1]);
-            }
-            // Close redirection fds if not stdin/stdout for this child
-            if (l->in  && in_fd_first  != STDIN_FILENO  && in_fd  != STDIN_FILENO)  close(in_fd_first);
-            if (l->out && out_fd_last  != STDOUT_FILENO && out_fd != STDOUT_FILENO) close(out_fd_last);
-
-            execvp(argv[0], argv);
-            perror("execvp");
-            _exit(127);
+        int in_fd   = prev_rd;
+        int out_fd  = out_fd_last;
+        int next_rd = STDIN_FILENO;
+        if (i < ncmds - 1) {
+            int p[2];
+            if (pipe_open(p, o->pipesz) < 0) { perror("pipe"); goto PIPE_FAIL; }
+            out_fd  = p[1];
+            next_rd = p[0];
         }
 
-        // Parent
+        const builtin_t *bi = plan ? plan->stage[i].bi : builtin_find(argv[0]);
+        spawn_req_t req = {
+            .file         = argv[0],
+            .path         = plan ? plan->stage[i].path : NULL,
+            .argv         = argv,
+            .in           = in_fd,
+            .out          = out_fd,
+            .close_others = 1,
+            .barrier_fd   = barrier[0],
+            // background pipelines form one process group led by stage 0
+            .setpgrp      = l->bg,
+            .pgid         = i > 0 ? pids[0] : 0,
+            // builtins and cat/tee stages run in a forked child
+            .builtin      = bi ? bi->fn : zc_classify(argv) != ZC_NONE ? zc_main : NULL,
+            .pin_cpu      = affinity_stage_cpu(i),
+            .cgroup_fd    = g_line_cg.fd,
+        };
+        pid_t pid = spawn_process(&req);
+
+        // Parent: this stage's ends now belong to the child
+        if (in_fd  != STDIN_FILENO)  close(in_fd);
+        if (out_fd != STDOUT_FILENO) close(out_fd);
+        if (i == ncmds - 1) out_fd_last = STDOUT_FILENO;
+        prev_rd = next_rd;
+
+        if (pid < 0) goto PIPE_FAIL;
         pids[i] = pid;
-
-        // After forking stage i:
-        if (i == 0 && in_fd_first != STDIN_FILENO) {
-            close(in_fd_first);
-            in_fd_first = STDIN_FILENO;
-        }
-        if (i > 0) {
-        
-            close(pipes[i-1][1]);
-        }
     }
 
-    // Parent
-    for (int k = 0; k < npipes; k++) {
-        close(pipes[k][0]);
-        close(pipes[k][1]);
-    }
-    if (out_fd_last != STDOUT_FILENO) close(out_fd_last);
+    // Release all stages at once
+    if (barrier[0] >= 0) { close(barrier[1]); close(barrier[0]); }
 
-    if (!l->bg) {
-        int status;
-        for (int t = 0; t < ncmds; t++) (void)waitpid(pids[t], &status, 0);
-    } else {
-        // Track pipeline as a background job via first PID (simple & sufficient here)
-        add_job(pids[0], g_last_cmdline);
+    if (l->bg) {
+        // Track the whole pipeline as one job: its process group
+        track_job(pids[0], pids, ncmds);
+        return EXIT_SUCCESS;
     }
 
-    free(pipes);
-    free(pids);
-    return EXIT_SUCCESS;
+    fg_wait_all(pids, ncmds, st);
+    // a planned binary that has gone away makes its child exit 127
+    for (int t = 0; plan && t < ncmds; t++)
+        if (st[t] == 127 && plan->stage[t].path) { plan_invalidate(plan); break; }
+    return st[ncmds - 1];
 
 PIPE_FAIL:
     // Cleanup on error during pipeline setup/forking
     {
         int saved = errno;
-        for (int k = 0; k < npipes; k++) { close(pipes[k][0]); close(pipes[k][1]); }
-        if (in_fd_first  != STDIN_FILENO)  close(in_fd_first);
+        if (prev_rd      != STDIN_FILENO)  close(prev_rd);
         if (out_fd_last  != STDOUT_FILENO) close(out_fd_last);
+        // Stages parked on the barrier must not run a half-built pipeline
+        if (barrier[0] >= 0) {
+            for (int t = 0; t < ncmds; t++) if (pids[t] > 0) kill(pids[t], SIGKILL);
+            close(barrier[1]);
+            close(barrier[0]);
+        }
         // Best-effort reap any already-forked children
-        for (int t = 0; t < ncmds; t++) if (pids && pids[t] > 0) (void)waitpid(pids[t], NULL, 0);
-        free(pipes);
-        free(pids);
+        for (int t = 0; t < ncmds; t++) if (pids[t] > 0) (void)waitpid(pids[t], NULL, 0);
         errno = saved;
-        return EXIT_FAILURE;
+        int rc = launch_failure();
+        for (int t = 0; t < ncmds; t++) st[t] = rc;
+        return rc;
     }
 }
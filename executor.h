@@ -0,0 +1,44 @@
+#pragma once
+
+#include <sys/types.h>
+
+struct cmdline;
+
+// How a command is joined to the one after it on the same line
+typedef enum {
+    SEQ_END = 0,    // last command of the list
+    SEQ_ALWAYS,     // `;` or `&`: run the next one regardless
+    SEQ_AND,        // `&&`: run the next one only on success
+    SEQ_OR,         // `||`: run the next one only on failure
+} seq_op_t;
+
+#define CMD_APPEND 0x1      // l->out was given as `>> file`
+
+typedef struct cmdlist {
+    struct cmdline *line;
+    seq_op_t        op;     // operator between this command and next
+    unsigned        flags;  // CMD_* bits struct cmdline has no room for
+    char          **literal;    // words with a '$' inside '...': not expanded
+                                // (NULL-terminated; NULL if none)
+    struct cmdlist *next;
+} cmdlist_t;
+
+// $? of the last command, and PIPESTATUS: one status per stage of the last
+// pipeline (g_npipestatus entries). Signalled stages report 128+signo.
+extern int  g_last_status;
+extern int *g_pipestatus;
+extern int  g_npipestatus;
+
+// Start one simple command and return its pid (-1 on failure) without
+// waiting; in/out are closed by the call
+pid_t launch_command(char* cmd, char** args, int in, int out, int pgrp);
+
+// Run one simple command; in/out are closed by the call (see executor.c)
+int execute_command(char* cmd, char** args, int in, int out, int bg);
+
+// Run a parsed command line (simple command or pipeline, builtins included)
+// and return its exit status
+int execute(struct cmdline *l);
+
+// Run a `;` / `&&` / `||` list, short-circuiting in the shell itself
+int execute_list(cmdlist_t *list);
@@ -0,0 +1,216 @@
+#define _GNU_SOURCE     // CLONE_PARENT, MSG_CMSG_CLOEXEC
+#include "forksrv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#define FORKSRV_MSG_MAX  (64 * 1024)
+#define FORKSRV_MAX_FDS  4               // in, out, err, barrier
+
+#define REQ_BARRIER 0x1
+
+typedef struct {
+    uint32_t argc;
+    uint32_t flags;
+    int32_t  pgid;          // group the child joins (0 = its own)
+    int32_t  pin_cpu;       // see spawn_req_t
+} req_hdr_t;
+
+static int   g_srv_sock = -1;
+static pid_t g_srv_pid  = -1;
+
+/* ---------- helper side ---------- */
+
+// Turn one request into a child of the shell; returns pid or -errno
+static int32_t serve(char *buf, size_t n, const int *fds, int nfds) {
+    req_hdr_t h;
+    if (n < sizeof(h) || nfds < 3) return -EINVAL;
+    memcpy(&h, buf, sizeof(h));
+    if (h.argc == 0 || h.argc > n) return -EINVAL;
+
+    // path\0 argv[0]\0 ... argv[argc-1]\0
+    char **argv = malloc(sizeof(char *) * (h.argc + 1));
+    if (!argv) return -ENOMEM;
+    char *p = buf + sizeof(h), *end = buf + n;
+    char *path = p;
+    for (uint32_t i = 0; i <= h.argc; ++i) {
+        char *z = memchr(p, '\0', (size_t)(end - p));
+        if (!z) { free(argv); return -EINVAL; }
+        if (i > 0) argv[i - 1] = p;
+        p = z + 1;
+    }
+    argv[h.argc] = NULL;
+
+    pid_t pid = (pid_t)syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0);
+    if (pid == 0) {
+        // parent is the shell: follow its cwd
+        char cwd[64];
+        snprintf(cwd, sizeof(cwd), "/proc/%d/cwd", (int)getppid());
+        if (chdir(cwd) < 0) { perror("fork server: chdir"); _exit(126); }
+        if (dup2(fds[2], STDERR_FILENO) < 0) _exit(126);
+
+        spawn_req_t r = {
+            .file         = argv[0],
+            .path         = path,
+            .argv         = argv,
+            .in           = fds[0],
+            .out          = fds[1],
+            .close_others = 1,
+            .barrier_fd   = (h.flags & REQ_BARRIER) && nfds > 3 ? fds[3] : -1,
+            .setpgrp      = 1,
+            .pgid         = h.pgid,
+            .pin_cpu      = h.pin_cpu,
+            .cgroup_fd    = -1,
+        };
+        spawn_child_exec(&r);
+    }
+    int32_t rc = pid < 0 ? -errno : pid;
+    free(argv);
+    return rc;
+}
+
+static void server_loop(int sock) __attribute__((noreturn));
+static void server_loop(int sock) {
+    static char buf[FORKSRV_MSG_MAX];
+    for (;;) {
+        union {
+            char           b[CMSG_SPACE(sizeof(int) * FORKSRV_MAX_FDS)];
+            struct cmsghdr align;
+        } cbuf;
+        struct iovec  iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+        struct msghdr mh  = { .msg_iov = &iov, .msg_iovlen = 1,
+                              .msg_control = cbuf.b, .msg_controllen = sizeof(cbuf.b) };
+
+        ssize_t n = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+        if (n == 0) _exit(0);                       // shell closed its end
+        if (n < 0) { if (errno == EINTR) continue; _exit(1); }
+
+        int fds[FORKSRV_MAX_FDS], nfds = 0;
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+            nfds = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            if (nfds > FORKSRV_MAX_FDS) nfds = FORKSRV_MAX_FDS;
+            memcpy(fds, CMSG_DATA(c), sizeof(int) * (size_t)nfds);
+        }
+
+        int32_t reply = serve(buf, (size_t)n, fds, nfds);
+        for (int k = 0; k < nfds; ++k) close(fds[k]);
+        (void)send(sock, &reply, sizeof(reply), MSG_NOSIGNAL);
+    }
+}
+
+/* ---------- shell side ---------- */
+
+int forksrv_start(void) {
+    if (g_srv_sock >= 0) return 0;
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        perror("fork server: socketpair");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork server: fork");
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        setpgid(0, 0);                  // keep terminal signals away from the helper
+        signal(SIGINT,  SIG_IGN);
+        signal(SIGQUIT, SIG_IGN);
+        // only stdio and our end of the socket survive
+        int s = sv[1];
+        syscall(SYS_close_range, STDERR_FILENO + 1, s - 1, 0);
+        syscall(SYS_close_range, s + 1, ~0U, 0);
+        server_loop(s);
+    }
+
+    close(sv[1]);
+    g_srv_sock = sv[0];
+    g_srv_pid  = pid;
+    return 0;
+}
+
+void forksrv_stop(void) {
+    if (g_srv_sock < 0) return;
+    close(g_srv_sock);                  // helper sees EOF and exits
+    g_srv_sock = -1;
+    (void)waitpid(g_srv_pid, NULL, 0);
+    g_srv_pid = -1;
+}
+
+pid_t forksrv_spawn(const spawn_req_t *r) {
+    // the helper cannot reach the shell's cgroup fds, and an audit has to
+    // see the shell's fd table, not the helper's
+    if (r->cgroup_fd >= 0 || g_fd_audit) return FORKSRV_UNAVAILABLE;
+    if (forksrv_start() < 0) return FORKSRV_UNAVAILABLE;
+
+    static char buf[FORKSRV_MSG_MAX];
+    req_hdr_t h = {
+        .flags = r->barrier_fd >= 0 ? REQ_BARRIER : 0,
+        // foreground children stay in the shell's group
+        .pgid  = r->setpgrp ? r->pgid : getpgrp(),
+        .pin_cpu = r->pin_cpu,
+    };
+
+    size_t n = sizeof(h);
+    const char *strs[] = { r->path };
+    for (int i = -1; i < 0 || r->argv[i]; ++i) {
+        const char *s = i < 0 ? strs[0] : r->argv[i];
+        size_t len = strlen(s) + 1;
+        if (n + len > sizeof(buf)) return FORKSRV_UNAVAILABLE;    // too big: fork locally
+        memcpy(buf + n, s, len);
+        n += len;
+        if (i >= 0) h.argc++;
+    }
+    memcpy(buf, &h, sizeof(h));
+
+    int fds[FORKSRV_MAX_FDS] = { r->in, r->out, STDERR_FILENO, r->barrier_fd };
+    int nfds = h.flags & REQ_BARRIER ? 4 : 3;
+    union {
+        char           b[CMSG_SPACE(sizeof(int) * FORKSRV_MAX_FDS)];
+        struct cmsghdr align;
+    } cbuf;
+    memset(&cbuf, 0, sizeof(cbuf));
+    struct iovec  iov = { .iov_base = buf, .iov_len = n };
+    struct msghdr mh  = { .msg_iov = &iov, .msg_iovlen = 1,
+                          .msg_control = cbuf.b, .msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)nfds) };
+    struct cmsghdr *c = CMSG_FIRSTHDR(&mh);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type  = SCM_RIGHTS;
+    c->cmsg_len   = CMSG_LEN(sizeof(int) * (size_t)nfds);
+    memcpy(CMSG_DATA(c), fds, sizeof(int) * (size_t)nfds);
+
+    int32_t reply;
+    ssize_t w;
+    while ((w = sendmsg(g_srv_sock, &mh, MSG_NOSIGNAL)) < 0 && errno == EINTR) { }
+    ssize_t rd = -1;
+    if (w >= 0) while ((rd = recv(g_srv_sock, &reply, sizeof(reply), 0)) < 0 && errno == EINTR) { }
+    if (rd != (ssize_t)sizeof(reply)) {
+        // helper died: drop it; the next launch starts a fresh one
+        fprintf(stderr, "fork server: lost, launching locally\n");
+        forksrv_stop();
+        return FORKSRV_UNAVAILABLE;
+    }
+
+    if (reply < 0) {
+        fprintf(stderr, "%s: %s\n", r->file, strerror(-reply));
+        errno = -reply;
+        return -1;
+    }
+    return (pid_t)reply;
+}
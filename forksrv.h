@@ -0,0 +1,24 @@
+#pragma once
+#include <sys/types.h>
+#include "launcher.h"
+
+// Fork server: a small helper process, started once, that performs launches
+// for the shell (`shopt spawn server`). Requests carry the resolved path and
+// argv; stdin/stdout/stderr (and the barrier, if any) travel as SCM_RIGHTS
+// over a SOCK_SEQPACKET socketpair. The helper creates children with
+// CLONE_PARENT, so they are ordinary children of the shell for wait/jobs.
+//
+// Children run in the shell's current directory but inherit the environment
+// the helper was started with.
+
+#define FORKSRV_UNAVAILABLE ((pid_t)-2)   // caller should launch by itself
+
+// Start the helper if it is not running; 0 on success
+int forksrv_start(void);
+
+// Launch through the helper. Returns the child's pid, -1 if the launch
+// failed (message printed), or FORKSRV_UNAVAILABLE.
+pid_t forksrv_spawn(const spawn_req_t *r);
+
+// Stop the helper (it also exits on its own when the shell goes away)
+void forksrv_stop(void);
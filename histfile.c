@@ -0,0 +1,318 @@
+#include "histfile.h"
+#include "out.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>     // kill(-pgid, 0)
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HF_MAGIC    "SHHIST01"
+#define HF_VERSION  1
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t hdr_size;      // records start here
+} hf_header_t;
+
+enum { HR_LINE = 1, HR_JOB_START, HR_JOB_EXIT };
+
+// On-disk record; len is a multiple of 8 so every header stays aligned
+typedef struct {
+    uint32_t len;           // whole record including padding
+    uint32_t sum;           // FNV-1a of the bytes after this field
+    uint32_t kind;
+    int32_t  shell;         // pid of the writer
+    int32_t  pgid;          // job records
+    int32_t  status;        // HR_JOB_EXIT: wait status
+    int64_t  time_ns;       // CLOCK_REALTIME
+    char     text[];        // NUL-terminated (empty for HR_JOB_EXIT)
+} hf_rec_t;
+
+typedef struct { uint64_t key; uint64_t off; } hf_ent_t;           // prefix index
+typedef struct { int32_t shell, pgid; uint64_t off; } hf_job_t;    // started, not exited
+
+static int         g_fd = -1;
+static char        g_path[PATH_MAX];
+static const char *g_map;
+static size_t      g_mapped;
+static size_t      g_scanned;       // file offset the indexes cover
+static int         g_write_warned;
+
+static hf_ent_t *g_idx;             // sorted by (key, off)
+static size_t    g_nidx, g_idx_cap;
+static hf_job_t *g_open;            // in start order
+static size_t    g_nopen, g_open_cap;
+
+static uint32_t fnv(const void *p, size_t n) {
+    const unsigned char *s = p;
+    uint32_t h = 2166136261u;
+    while (n--) { h ^= *s++; h *= 16777619u; }
+    return h;
+}
+
+// First 8 bytes of s, big-endian, so integer order is string order
+static uint64_t key8(const char *s, unsigned fill) {
+    uint64_t k = 0;
+    int i = 0;
+    for (; i < 8 && s[i]; i++) k = k << 8 | (unsigned char)s[i];
+    for (; i < 8; i++) k = k << 8 | fill;
+    return k;
+}
+
+static int grow(void **arr, size_t *cap, size_t need, size_t size) {
+    if (need <= *cap) return 0;
+    size_t n = *cap ? *cap * 2 : 256;
+    while (n < need) n *= 2;
+    void *p = realloc(*arr, n * size);
+    if (!p) return -1;
+    *arr = p;
+    *cap = n;
+    return 0;
+}
+
+/* ---------- open / close ---------- */
+
+static void hf_close(void) {
+    if (g_map) munmap((void *)g_map, g_mapped);
+    if (g_fd >= 0) close(g_fd);
+    free(g_idx);
+    free(g_open);
+    g_map = NULL;
+    g_mapped = g_scanned = 0;
+    g_fd = -1;
+    g_idx = NULL;  g_nidx = g_idx_cap = 0;
+    g_open = NULL; g_nopen = g_open_cap = 0;
+    g_path[0] = 0;
+}
+
+// The header is written to a private file first and linked into place,
+// so no shell ever sees (or appends to) a file without one
+static int create_file(const char *path) {
+    char tmp[PATH_MAX];
+    if ((size_t)snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid()) >= sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+
+    hf_header_t h = { .version = HF_VERSION, .hdr_size = sizeof(h) };
+    memcpy(h.magic, HF_MAGIC, sizeof(h.magic));
+    int rc = write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h) ? 0 : -1;
+    close(fd);
+    if (rc == 0 && link(tmp, path) < 0 && errno != EEXIST) rc = -1;
+    int saved = errno;
+    unlink(tmp);
+    errno = saved;
+    return rc;
+}
+
+int histfile_open(const char *spec) {
+    if (strcmp(spec, "off") == 0) { hf_close(); return 0; }
+    if (strlen(spec) >= sizeof(g_path)) return -1;
+
+    int fd = open(spec, O_RDWR | O_APPEND | O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT) {
+        if (create_file(spec) < 0) { perror(spec); return -1; }
+        fd = open(spec, O_RDWR | O_APPEND | O_CLOEXEC);
+    }
+    if (fd < 0) { perror(spec); return -1; }
+
+    hf_header_t h;
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, HF_MAGIC, sizeof(h.magic)) != 0 ||
+        h.version != HF_VERSION || h.hdr_size < sizeof(h) || h.hdr_size % 8) {
+        fprintf(stderr, "%s: not a shell history file\n", spec);
+        close(fd);
+        return -1;
+    }
+    hf_close();
+    g_fd = fd;
+    g_scanned = h.hdr_size;
+    g_write_warned = 0;
+    snprintf(g_path, sizeof(g_path), "%s", spec);
+    return 0;
+}
+
+void histfile_show(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_fd >= 0 ? g_path : "off");
+}
+
+/* ---------- writing ---------- */
+
+static void append(uint32_t kind, pid_t pgid, int status, const char *text) {
+    if (g_fd < 0) return;
+
+    // one write() per record: O_APPEND keeps concurrent shells' records whole
+    uint64_t buf[(sizeof(hf_rec_t) + HISTFILE_TEXT_MAX + 7) / 8];
+    size_t tlen = text ? strnlen(text, HISTFILE_TEXT_MAX - 1) : 0;
+    size_t len  = (sizeof(hf_rec_t) + tlen + 1 + 7) & ~(size_t)7;
+    memset(buf, 0, len);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    hf_rec_t *r = (hf_rec_t *)buf;
+    r->len     = (uint32_t)len;
+    r->kind    = kind;
+    r->shell   = (int32_t)getpid();
+    r->pgid    = (int32_t)pgid;
+    r->status  = status;
+    r->time_ns = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    if (tlen) memcpy(r->text, text, tlen);
+    r->sum = fnv((const char *)buf + 8, len - 8);
+
+    if (write(g_fd, buf, len) != (ssize_t)len && !g_write_warned) {
+        g_write_warned = 1;
+        fprintf(stderr, "histfile: %s: %s\n", g_path, strerror(errno));
+    }
+}
+
+void histfile_add_line(const char *line) { append(HR_LINE, 0, 0, line); }
+void histfile_job_start(pid_t pgid, const char *cmdline) { append(HR_JOB_START, pgid, 0, cmdline ? cmdline : ""); }
+void histfile_job_exit(pid_t pgid, int status) { append(HR_JOB_EXIT, pgid, status, NULL); }
+
+/* ---------- reading ---------- */
+
+// Extend the mapping to the current end of file
+static int remap(void) {
+    struct stat st;
+    if (fstat(g_fd, &st) < 0) return -1;
+    size_t size = (size_t)st.st_size;
+    if (size <= g_mapped) return 0;
+
+    if (g_map) munmap((void *)g_map, g_mapped);
+    void *m = mmap(NULL, size, PROT_READ, MAP_SHARED, g_fd, 0);
+    if (m == MAP_FAILED) { g_map = NULL; g_mapped = 0; return -1; }
+    g_map    = m;
+    g_mapped = size;
+    return 0;
+}
+
+// The complete record at off, or NULL (end of file, or still being written)
+static const hf_rec_t *rec_at(size_t off) {
+    if (off > g_mapped || g_mapped - off < sizeof(hf_rec_t)) return NULL;
+    const hf_rec_t *r = (const hf_rec_t *)(g_map + off);
+    if (r->len < sizeof(*r) + 1 || r->len % 8 || r->len > g_mapped - off) return NULL;
+    if (g_map[off + r->len - 1] != 0) return NULL;
+    if (fnv(g_map + off + 8, r->len - 8) != r->sum) return NULL;
+    return r;
+}
+
+static int ent_cmp(const void *a, const void *b) {
+    const hf_ent_t *x = a, *y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return x->off < y->off ? -1 : x->off > y->off;
+}
+
+// Merge the unsorted tail g_idx[first..] into the sorted head
+static int merge_tail(size_t first) {
+    qsort(g_idx + first, g_nidx - first, sizeof(hf_ent_t), ent_cmp);
+    if (first == 0) return 0;
+
+    hf_ent_t *out = malloc(sizeof(hf_ent_t) * g_nidx);
+    if (!out) return -1;
+    size_t a = 0, b = first, k = 0;
+    while (a < first && b < g_nidx) out[k++] = ent_cmp(&g_idx[a], &g_idx[b]) <= 0 ? g_idx[a++] : g_idx[b++];
+    while (a < first)  out[k++] = g_idx[a++];
+    while (b < g_nidx) out[k++] = g_idx[b++];
+    memcpy(g_idx, out, sizeof(hf_ent_t) * g_nidx);
+    free(out);
+    return 0;
+}
+
+static void job_closed(int32_t shell, int32_t pgid) {
+    for (size_t i = g_nopen; i-- > 0; ) {
+        if (g_open[i].shell != shell || g_open[i].pgid != pgid) continue;
+        memmove(&g_open[i], &g_open[i + 1], sizeof(hf_job_t) * (g_nopen - i - 1));
+        g_nopen--;
+        return;
+    }
+}
+
+// Index the records appended since the last call
+static int catch_up(void) {
+    if (remap() < 0) { perror("histfile"); return -1; }
+
+    size_t first = g_nidx;
+    const hf_rec_t *r;
+    while ((r = rec_at(g_scanned)) != NULL) {
+        if (r->kind == HR_LINE) {
+            if (grow((void **)&g_idx, &g_idx_cap, g_nidx + 1, sizeof(hf_ent_t)) < 0) break;
+            g_idx[g_nidx++] = (hf_ent_t){ .key = key8(r->text, 0), .off = g_scanned };
+        } else if (r->kind == HR_JOB_START) {
+            if (grow((void **)&g_open, &g_open_cap, g_nopen + 1, sizeof(hf_job_t)) < 0) break;
+            g_open[g_nopen++] = (hf_job_t){ .shell = r->shell, .pgid = r->pgid, .off = g_scanned };
+        } else if (r->kind == HR_JOB_EXIT) {
+            job_closed(r->shell, r->pgid);
+        }
+        g_scanned += r->len;
+    }
+    if (g_nidx > first && merge_tail(first) < 0) {
+        g_nidx = first;         // index again next time
+        fprintf(stderr, "histfile: %s\n", strerror(ENOMEM));
+        return -1;
+    }
+    return 0;
+}
+
+static int off_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int histfile_prefix(const char *prefix) {
+    if (g_fd < 0) return -1;
+    if (catch_up() < 0 && !g_map) return 0;
+
+    // every line with this prefix has a key in [lo, hi]
+    size_t plen = strlen(prefix);
+    uint64_t lo = key8(prefix, 0), hi = key8(prefix, 0xff);
+    size_t b = 0, e = g_nidx;
+    while (b < e) {
+        size_t m = b + (e - b) / 2;
+        if (g_idx[m].key < lo) b = m + 1; else e = m;
+    }
+    size_t n = 0;
+    while (e < g_nidx && g_idx[e].key <= hi) n++, e++;
+
+    uint64_t *hits = malloc(sizeof(uint64_t) * (n ? n : 1));
+    if (!hits) { fprintf(stderr, "histfile: %s\n", strerror(ENOMEM)); return 0; }
+    size_t k = 0;
+    for (size_t i = b; i < b + n; i++) {
+        const hf_rec_t *r = (const hf_rec_t *)(g_map + g_idx[i].off);
+        if (strncmp(r->text, prefix, plen) == 0) hits[k++] = g_idx[i].off;
+    }
+    qsort(hits, k, sizeof(uint64_t), off_cmp);
+    for (size_t i = 0; i < k; i++) {
+        const hf_rec_t *r = (const hf_rec_t *)(g_map + hits[i]);
+        out_printf("%7d  %s\n", r->shell, r->text);
+    }
+    free(hits);
+    return (int)k;
+}
+
+int histfile_jobs(void) {
+    if (g_fd < 0) return -1;
+    if (catch_up() < 0 && !g_map) return 0;
+
+    int n = 0;
+    size_t keep = 0;
+    for (size_t i = 0; i < g_nopen; i++) {
+        hf_job_t *j = &g_open[i];
+        // a group that is gone without an exit record (its shell was
+        // killed) will never get one
+        if (kill(-j->pgid, 0) < 0 && errno == ESRCH) continue;
+        g_open[keep++] = *j;
+        const hf_rec_t *r = (const hf_rec_t *)(g_map + j->off);
+        out_printf("[%d:%d] Running  %s\n", j->shell, j->pgid, r->text[0] ? r->text : "(unknown)");
+        n++;
+    }
+    g_nopen = keep;
+    return n;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// Shared history and job-state file (`shopt histfile FILE | off`): an
+// append-only log of fixed-header binary records that every shell pointed
+// at the same file writes with one O_APPEND write() per record and reads
+// through a read-only MAP_SHARED mapping, so no text is parsed. Each
+// record carries a checksum; a reader stops at a record still being
+// written. Each reader keeps a sorted index over the first 8 bytes of
+// every command line for `history --prefix`, and the jobs started and not
+// yet exited in any shell for `jobs --all`; both are extended only by the
+// records appended since the last query. Lines are stored up to
+// HISTFILE_TEXT_MAX bytes.
+
+#define HISTFILE_TEXT_MAX 4096
+
+int  histfile_open(const char *spec);   // 0, or -1 (message printed)
+void histfile_show(char *buf, size_t n);
+
+// No-ops while the file is off
+void histfile_add_line(const char *line);
+void histfile_job_start(pid_t pgid, const char *cmdline);
+void histfile_job_exit(pid_t pgid, int status);
+
+// Print lines starting with prefix, oldest first, with the pid of the
+// shell that ran them (through out.h). Returns the number printed, -1 if
+// the file is off.
+int histfile_prefix(const char *prefix);
+
+// Print jobs of every shell on the file whose process group is still
+// alive. Returns the number printed, -1 if the file is off.
+int histfile_jobs(void);
@@ -0,0 +1,50 @@
+#include "history.h"
+#include "strpool.h"
+#include "histfile.h"
+#include "out.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *g_hist[HISTORY_SIZE];   // ring of interned lines
+static unsigned    g_hist_next;            // total lines ever added
+
+void history_add(const char *line) {
+    if (!line || !*line) return;
+    const char *s = str_intern(line);
+    if (!s) return;
+
+    const char **slot = &g_hist[g_hist_next % HISTORY_SIZE];
+    str_release(*slot);     // oldest entry falls off the ring
+    *slot = s;
+    g_hist_next++;
+    histfile_add_line(line);
+}
+
+const char *history_last(void) {
+    if (g_hist_next == 0) return NULL;
+    return g_hist[(g_hist_next - 1) % HISTORY_SIZE];
+}
+
+// `history --prefix STR`: the shared file if there is one, else this shell's ring
+static int history_prefix(const char *prefix) {
+    if (histfile_prefix(prefix) >= 0) return 0;
+    size_t n = strlen(prefix);
+    unsigned first = g_hist_next > HISTORY_SIZE ? g_hist_next - HISTORY_SIZE : 0;
+    for (unsigned i = first; i < g_hist_next; ++i)
+        if (strncmp(g_hist[i % HISTORY_SIZE], prefix, n) == 0)
+            out_printf("%5u  %s\n", i + 1, g_hist[i % HISTORY_SIZE]);
+    return 0;
+}
+
+int builtin_history(char **argv) {
+    if (argv[1] && strcmp(argv[1], "--prefix") == 0 && argv[2] && !argv[3])
+        return history_prefix(argv[2]);
+    if (argv[1]) {
+        fprintf(stderr, "history: usage: history [--prefix STR]\n");
+        return 2;
+    }
+    unsigned first = g_hist_next > HISTORY_SIZE ? g_hist_next - HISTORY_SIZE : 0;
+    for (unsigned i = first; i < g_hist_next; ++i)
+        out_printf("%5u  %s\n", i + 1, g_hist[i % HISTORY_SIZE]);
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#define HISTORY_SIZE 1000
+
+// Record an executed command line. The text is interned, so a job started
+// from the same line shares the history entry's copy.
+void history_add(const char *line);
+
+// Most recent entry (interned, no reference taken), or NULL
+const char *history_last(void);
+
+// `history` builtin: list remembered lines, oldest first.
+// `history --prefix STR` lists the lines starting with STR, from every
+// shell when `shopt histfile` is set (see histfile.h).
+int builtin_history(char **argv);
@@ -0,0 +1,182 @@
+#include "jobevents.h"
+#include "out.h"         // job_print_json()
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define EVENTS_FLUSH_AT (64 * 1024)     // write once this much is pending
+#define EVENTS_MAX      (1 << 20)       // a stalled reader loses events past this
+
+typedef struct {
+    char  *p;
+    size_t len, cap;
+} jbuf_t;
+
+static int    g_ev_fd = -1;
+static char   g_ev_spec[128] = "off";
+static jbuf_t g_ev_buf;
+static unsigned long g_ev_dropped;
+
+static void ev_close(void) {
+    if (g_ev_fd >= 0) close(g_ev_fd);
+    g_ev_fd = -1;
+    g_ev_buf.len = 0;
+    g_ev_dropped = 0;
+    snprintf(g_ev_spec, sizeof(g_ev_spec), "off");
+}
+
+static void jb_printf(jbuf_t *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void jb_printf(jbuf_t *b, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->p ? b->p + b->len : NULL, b->p ? b->cap - b->len : 0, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if (b->p && b->len + (size_t)n < b->cap) { b->len += (size_t)n; return; }
+
+        size_t ncap = b->cap ? b->cap * 2 : 4096;
+        while (ncap <= b->len + (size_t)n) ncap *= 2;
+        char *np = realloc(b->p, ncap);
+        if (!np) return;
+        b->p = np;
+        b->cap = ncap;
+    }
+}
+
+static void jb_string(jbuf_t *b, const char *s) {
+    jb_printf(b, "\"");
+    for (; s && *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') jb_printf(b, "\\%c", c);
+        else if (c < 0x20)         jb_printf(b, "\\u%04x", c);
+        else                       jb_printf(b, "%c", c);
+    }
+    jb_printf(b, "\"");
+}
+
+static double tv_sec(const struct timeval *tv) {
+    return (double)tv->tv_sec + (double)tv->tv_usec / 1e6;
+}
+
+static double ts_diff(const struct timespec *a, const struct timespec *b) {
+    return (double)(b->tv_sec - a->tv_sec) + (double)(b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static void format_job(jbuf_t *b, const char *event, const job_t *j) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    jb_printf(b, "{");
+    if (event) jb_printf(b, "\"event\":\"%s\",", event);
+    jb_printf(b, "\"time\":%ld.%06ld,\"pgid\":%d,\"state\":\"%s\",\"cmd\":",
+              (long)now.tv_sec, now.tv_nsec / 1000, (int)j->pgid, j->done ? "done" : "running");
+    jb_string(b, j->cmdline);
+    jb_printf(b, ",\"pids\":[");
+    for (int k = 0, first = 1; k < j->nprocs; ++k) {
+        if (j->procs[k].pid <= 0) continue;
+        jb_printf(b, first ? "%d" : ",%d", (int)j->procs[k].pid);
+        first = 0;
+    }
+    jb_printf(b, "]");
+    if (j->done) {
+        if (WIFSIGNALED(j->status)) jb_printf(b, ",\"status\":null,\"signal\":%d", WTERMSIG(j->status));
+        else                        jb_printf(b, ",\"status\":%d,\"signal\":null", WEXITSTATUS(j->status));
+        const struct rusage *ru = &j->ru;
+        jb_printf(b, ",\"real\":%.6f,\"user\":%.6f,\"sys\":%.6f,\"maxrss_kb\":%ld,"
+                     "\"minflt\":%ld,\"majflt\":%ld,\"nvcsw\":%ld,\"nivcsw\":%ld",
+                  ts_diff(&j->start, &j->end), tv_sec(&ru->ru_utime), tv_sec(&ru->ru_stime),
+                  ru->ru_maxrss, ru->ru_minflt, ru->ru_majflt, ru->ru_nvcsw, ru->ru_nivcsw);
+    }
+    if (j->has_cgstats) {
+        const cg_stats_t *st = &j->cgstats;
+        jb_printf(b, ",\"psi_cpu_us\":%lld,\"psi_mem_us\":%lld,\"psi_io_us\":%lld,\"memory_peak\":%lld",
+                  st->cpu_some_us, st->mem_some_us, st->io_some_us, st->mem_peak);
+    }
+    jb_printf(b, "}\n");
+}
+
+void job_event(const char *event, const job_t *j) {
+    if (g_ev_fd < 0) return;
+    if (g_ev_buf.len > EVENTS_MAX) {
+        // the reader is not keeping up: drop what it has not taken
+        g_ev_dropped++;
+        return;
+    }
+    format_job(&g_ev_buf, event, j);
+    if (g_ev_buf.len >= EVENTS_FLUSH_AT) job_events_flush();
+}
+
+void job_events_flush(void) {
+    if (g_ev_fd < 0) return;
+    if (g_ev_dropped && g_ev_buf.len <= EVENTS_MAX) {
+        jb_printf(&g_ev_buf, "{\"event\":\"dropped\",\"count\":%lu}\n", g_ev_dropped);
+        g_ev_dropped = 0;
+    }
+    size_t off = 0;
+    while (off < g_ev_buf.len) {
+        ssize_t w = write(g_ev_fd, g_ev_buf.p + off, g_ev_buf.len - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) break;     // socket full: keep the rest for later
+            perror("jobevents");
+            ev_close();
+            return;
+        }
+        off += (size_t)w;
+    }
+    memmove(g_ev_buf.p, g_ev_buf.p + off, g_ev_buf.len - off);
+    g_ev_buf.len -= off;
+}
+
+static int connect_unix(const char *path) {
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(sa.sun_path)) { errno = ENAMETOOLONG; return -1; }
+    strcpy(sa.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) { close(fd); return -1; }
+    return fd;
+}
+
+int job_events_open(const char *spec) {
+    int fd = -1;
+    if (strcmp(spec, "off") == 0) {
+        fd = -1;
+    } else if (strncmp(spec, "fd:", 3) == 0) {
+        char *end;
+        long n = strtol(spec + 3, &end, 10);
+        if (end == spec + 3 || *end || n < 0) return -1;
+        fd = fcntl((int)n, F_DUPFD_CLOEXEC, 3);    // our own copy
+    } else if (strncmp(spec, "unix:", 5) == 0) {
+        fd = connect_unix(spec + 5);
+    } else if (spec[0] == '/') {
+        fd = open(spec, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    } else {
+        return -1;
+    }
+    if (fd < 0 && strcmp(spec, "off") != 0) { perror(spec); return -1; }
+    if (strlen(spec) >= sizeof(g_ev_spec)) { if (fd >= 0) close(fd); return -1; }
+
+    job_events_flush();
+    ev_close();
+    g_ev_fd = fd;
+    snprintf(g_ev_spec, sizeof(g_ev_spec), "%s", spec);
+    return 0;
+}
+
+void job_events_show(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_ev_spec);
+}
+
+void job_print_json(const job_t *j) {
+    jbuf_t b = { 0 };
+    format_job(&b, NULL, j);
+    if (b.p) out_write(b.p, b.len);
+    free(b.p);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdio.h>
+#include <stddef.h>
+#include "jobs.h"
+
+// Newline-delimited JSON job events, selected with `shopt jobevents`:
+//   off | fd:N | unix:/path/to/socket | /path/to/file (appended)
+// Every job emits a "start" and an "exit" object; the exit carries the
+// status or signal and the job's rusage. Events are buffered and written
+// in batches: after each reap pass and after each command line.
+int  job_events_open(const char *spec);     // 0, or -1 (message printed)
+void job_events_show(char *buf, size_t n);
+
+void job_event(const char *event, const job_t *j);
+void job_events_flush(void);
+
+// One job as a JSON object on its own line, to the builtin output layer
+// (`jobs --json`; see out.h)
+void job_print_json(const job_t *j);
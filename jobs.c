@@ -1,36 +1,342 @@
-
+#define _GNU_SOURCE
 #include "jobs.h"
+#include "strpool.h"
+#include "jobevents.h"
+#include "histfile.h"
+#include "out.h"
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
 #include <string.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+
+#define JOBS_INITIAL_CAP 64
+
+job_table_t g_jobs = { .free_head = -1, .epfd = -1, .done_head = -1, .done_tail = -1 };
+
+static unsigned pid_bucket(pid_t pgid) {
+    return ((unsigned)pgid * 2654435761u) & (unsigned)(g_jobs.nbuckets - 1);
+}
+
+static void hash_insert(int idx) {
+    unsigned b = pid_bucket(g_jobs.slots[idx].pgid);
+    g_jobs.slots[idx].next = g_jobs.buckets[b];
+    g_jobs.buckets[b] = idx;
+}
+
+static void hash_remove(int idx) {
+    int *pp = &g_jobs.buckets[pid_bucket(g_jobs.slots[idx].pgid)];
+    while (*pp >= 0) {
+        if (*pp == idx) { *pp = g_jobs.slots[idx].next; return; }
+        pp = &g_jobs.slots[*pp].next;
+    }
+}
+
+// Double slots and buckets; every active job is rehashed once
+static int grow_table(void) {
+    int ncap = g_jobs.cap ? g_jobs.cap * 2 : JOBS_INITIAL_CAP;
+    job_t *ns = realloc(g_jobs.slots, sizeof(job_t) * (size_t)ncap);
+    if (!ns) return -1;
+    g_jobs.slots = ns;
+
+    int *nb = malloc(sizeof(int) * (size_t)ncap);
+    if (!nb) return -1;
+    free(g_jobs.buckets);
+    g_jobs.buckets  = nb;
+    g_jobs.nbuckets = ncap;
+    for (int b = 0; b < ncap; ++b) nb[b] = -1;
+    for (int i = 0; i < g_jobs.used; ++i)
+        if (g_jobs.slots[i].active) hash_insert(i);
+
+    g_jobs.cap = ncap;
+    return 0;
+}
+
+static int alloc_slot(void) {
+    if (g_jobs.free_head >= 0) {
+        int idx = g_jobs.free_head;
+        g_jobs.free_head = g_jobs.slots[idx].next;
+        return idx;
+    }
+    if (g_jobs.used == g_jobs.cap && grow_table() < 0) return -1;
+    return g_jobs.used++;
+}
+
+static void forget_proc(job_proc_t *p) {
+    if (p->pidfd >= 0) close(p->pidfd);     // also drops it from the epoll set
+    p->pidfd = -1;
+    p->pid   = 0;
+}
+
+static void release_slot(int idx) {
+    job_t *j = &g_jobs.slots[idx];
+    hash_remove(idx);
+    free(j->procs);
+    str_release(j->cmdline);
+    j->procs   = NULL;
+    j->cmdline = NULL;
+    j->active  = 0;
+    j->next    = g_jobs.free_head;
+    g_jobs.free_head = idx;
+    g_jobs.nactive--;
+}
+
+// Oldest finished job off the done list, or -1 if there is none
+static int pop_done(void) {
+    int idx = g_jobs.done_head;
+    if (idx < 0) return -1;
+    g_jobs.done_head = g_jobs.slots[idx].done_next;
+    if (g_jobs.done_head < 0) g_jobs.done_tail = -1;
+    g_jobs.ndone--;
+    return idx;
+}
+
+// Stop watching a job whose stages are all reaped; keep it for `jobs`,
+// dropping the oldest unreported one once JOBS_DONE_MAX are kept
+static void finish_job(int idx) {
+    job_t *j = &g_jobs.slots[idx];
+    for (int k = 0; k < j->nprocs; ++k) forget_proc(&j->procs[k]);
+    if (j->polled) g_jobs.npolled--;
+    j->polled = 0;
+    j->done   = 1;
+    clock_gettime(CLOCK_MONOTONIC, &j->end);
+    if (j->cg.fd >= 0) {
+        cg_read_stats(&j->cg, &j->cgstats);
+        j->has_cgstats = 1;
+        cg_destroy(&j->cg);
+    }
+    job_event("exit", j);
+    histfile_job_exit(j->pgid, j->status);
+
+    if (g_jobs.ndone == JOBS_DONE_MAX) release_slot(pop_done());
+    j->done_next = -1;
+    if (g_jobs.done_tail >= 0) g_jobs.slots[g_jobs.done_tail].done_next = idx;
+    else                       g_jobs.done_head = idx;
+    g_jobs.done_tail = idx;
+    g_jobs.ndone++;
+}
+
+// epoll cookie: job slot in the high half, stage in the low half
+static uint64_t cookie(int idx, int k) { return ((uint64_t)(unsigned)idx << 32) | (unsigned)k; }
+
+// Watch one stage's pidfd; returns -1 if the kernel can't give us one
+static int watch_proc(int idx, int k) {
+    if (g_jobs.epfd < 0) {
+        g_jobs.epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (g_jobs.epfd < 0) return -1;
+    }
 
-job_t g_jobs[MAX_JOBS] = {0};
+    job_proc_t *p = &g_jobs.slots[idx].procs[k];
+    int fd = (int)syscall(SYS_pidfd_open, p->pid, 0);  // O_CLOEXEC by default
+    if (fd < 0) return -1;
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = cookie(idx, k) };
+    if (epoll_ctl(g_jobs.epfd, EPOLL_CTL_ADD, fd, &ev) < 0) { close(fd); return -1; }
+    p->pidfd = fd;
+    return 0;
+}
+
+int add_job(pid_t pgid, const pid_t *pids, int npids, const char *cmdline) {
+    int idx = alloc_slot();
+    job_proc_t *procs = idx < 0 ? NULL : malloc(sizeof(job_proc_t) * (size_t)npids);
+    if (!procs) {
+        if (idx >= 0) { g_jobs.slots[idx].next = g_jobs.free_head; g_jobs.free_head = idx; }
+        fprintf(stderr, "jobs: out of memory\n");
+        return -1;
+    }
+
+    job_t *j = &g_jobs.slots[idx];
+    j->pgid    = pgid;
+    j->active  = 1;
+    j->cmdline = str_intern(cmdline);      // NULL on OOM; printed as (unknown)
+    j->procs   = procs;
+    j->nprocs  = npids;
+    j->nlive   = npids;
+    j->polled  = 0;
+    j->done    = 0;
+    j->status  = 0;
+    j->cg.fd   = -1;
+    j->has_cgstats = 0;
+    memset(&j->ru, 0, sizeof(j->ru));
+    clock_gettime(CLOCK_MONOTONIC, &j->start);
+    hash_insert(idx);
+    g_jobs.nactive++;
+
+    for (int k = 0; k < npids; ++k) {
+        procs[k].pid   = pids[k];
+        procs[k].pidfd = -1;
+        if (watch_proc(idx, k) < 0) j->polled = 1;
+    }
+    if (j->polled) g_jobs.npolled++;
+    job_event("start", j);
+    histfile_job_start(pgid, j->cmdline);
+    return idx;
+}
+
+void job_attach_cgroup(int idx, cg_job_t cg) {
+    g_jobs.slots[idx].cg = cg;
+}
 
-int add_job(pid_t pid, const char *cmdline) {
-    for (int i = 0; i < MAX_JOBS; ++i) {
-        if (!g_jobs[i].active) {
-            g_jobs[i].pid    = pid;
-            g_jobs[i].active = 1;
-            // keep it short; avoid overflow
-            snprintf(g_jobs[i].cmdline, sizeof(g_jobs[i].cmdline), "%s", cmdline ? cmdline : "");
-            return i;
+static void tv_add(struct timeval *a, const struct timeval *b) {
+    a->tv_sec  += b->tv_sec;
+    a->tv_usec += b->tv_usec;
+    if (a->tv_usec >= 1000000) { a->tv_sec++; a->tv_usec -= 1000000; }
+}
+
+void rusage_add(struct rusage *acc, const struct rusage *r) {
+    tv_add(&acc->ru_utime, &r->ru_utime);
+    tv_add(&acc->ru_stime, &r->ru_stime);
+    if (r->ru_maxrss < 0 || acc->ru_maxrss < 0) acc->ru_maxrss = -1;
+    else if (r->ru_maxrss > acc->ru_maxrss)   acc->ru_maxrss = r->ru_maxrss;
+    acc->ru_minflt += r->ru_minflt;
+    acc->ru_majflt += r->ru_majflt;
+    acc->ru_nvcsw  += r->ru_nvcsw;
+    acc->ru_nivcsw += r->ru_nivcsw;
+}
+
+static void tv_sub(struct timeval *a, const struct timeval *b) {
+    a->tv_sec  -= b->tv_sec;
+    a->tv_usec -= b->tv_usec;
+    if (a->tv_usec < 0) { a->tv_sec--; a->tv_usec += 1000000; }
+}
+
+void rusage_delta(struct rusage *acc, const struct rusage *r) {
+    tv_sub(&acc->ru_utime, &r->ru_utime);
+    tv_sub(&acc->ru_stime, &r->ru_stime);
+    acc->ru_minflt -= r->ru_minflt;
+    acc->ru_majflt -= r->ru_majflt;
+    acc->ru_nvcsw  -= r->ru_nvcsw;
+    acc->ru_nivcsw -= r->ru_nivcsw;
+}
+
+static double tv_sec(const struct timeval *tv) {
+    return (double)tv->tv_sec + (double)tv->tv_usec / 1e6;
+}
+
+static const char *maxrss_str(long kb, char *buf, size_t n) {
+    if (kb < 0) return "n/a";
+    snprintf(buf, n, "%ldk", kb);
+    return buf;
+}
+
+// Shared by print_rusage() (stdio, for `time`) and `jobs` (out.h)
+#define RUSAGE_FMT "real %.3fs user %.3fs sys %.3fs maxrss %s minflt %ld majflt %ld nvcsw %ld nivcsw %ld\n"
+#define RUSAGE_ARGS(ru, real_sec) \
+    (real_sec), tv_sec(&(ru)->ru_utime), tv_sec(&(ru)->ru_stime), \
+    maxrss_str((ru)->ru_maxrss, (char[24]){ 0 }, 24), \
+    (ru)->ru_minflt, (ru)->ru_majflt, (ru)->ru_nvcsw, (ru)->ru_nivcsw
+
+void print_rusage(FILE *f, const struct rusage *ru, double real_sec) {
+    fprintf(f, RUSAGE_FMT, RUSAGE_ARGS(ru, real_sec));
+}
+
+// Collect an exited stage with wait4() so its rusage lands in the job
+static int collect(job_t *j, pid_t pid, int *status) {
+    struct rusage ru;
+    pid_t r = wait4(pid, status, WNOHANG, &ru);
+    if (r == 0) errno = 0;      // still running
+    if (r != pid) return -1;
+    rusage_add(&j->ru, &ru);
+    rusage_add(&g_jobs.reaped_ru, &ru);
+    return 0;
+}
+
+// The job's status is the one of its last stage, like a shell pipeline
+static void proc_exited(job_t *j, pid_t pid, int status) {
+    for (int k = 0; k < j->nprocs; ++k) {
+        if (j->procs[k].pid == pid) {
+            if (k == j->nprocs - 1) j->status = status;
+            forget_proc(&j->procs[k]);
+            j->nlive--;
+            return;
         }
     }
-    fprintf(stderr, "jobs: job table full\n");
-    return -1;
+}
+
+// Reap every exited stage of the job in one pass over its process group.
+// `hint` is the stage whose pidfd fired (-1 when polling); it is reaped by
+// pid as well in case it left the group. Once the group has no children
+// left, every stage not accounted for yet is tried by pid the same way.
+static void reap_job(int idx, int hint) {
+    job_t *j = &g_jobs.slots[idx];
+    if (!j->active || j->done) return;
+
+    int group_gone = 0;
+    while (j->nlive > 0) {
+        // peek with WNOWAIT, then wait4() the stage to get its rusage
+        siginfo_t si;
+        si.si_pid = 0;
+        if (waitid(P_PGID, (id_t)j->pgid, &si, WEXITED | WNOHANG | WNOWAIT) < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ECHILD) { group_gone = 1; break; }    // nothing of this group is left
+            return;
+        }
+        if (si.si_pid == 0) break;             // the rest are still running
+        int status = 0;
+        if (collect(j, si.si_pid, &status) < 0) break;
+        proc_exited(j, si.si_pid, status);
+    }
+
+    for (int k = 0; k < j->nprocs && j->nlive > 0; ++k) {
+        if (j->procs[k].pid <= 0 || (!group_gone && k != hint)) continue;
+        pid_t pid = j->procs[k].pid;
+        int status = 0;
+        if (collect(j, pid, &status) == 0 || errno == ECHILD) proc_exited(j, pid, status);
+    }
+    if (j->nlive == 0) finish_job(idx);
 }
 
 void reap_finished_jobs(void) {
-    int status;
-    for (int i = 0; i < MAX_JOBS; ++i) {
-        if (!g_jobs[i].active) continue;
-        pid_t r = waitpid(g_jobs[i].pid, &status, WNOHANG);
-        if (r == g_jobs[i].pid) {
-            // child changed state (exited or was signalled)
-            g_jobs[i].active = 0;
+    if (g_jobs.nactive == 0) return;
+
+    if (g_jobs.epfd >= 0) {
+        struct epoll_event evs[64];
+        int n;
+        do {
+            n = epoll_wait(g_jobs.epfd, evs, 64, 0);
+            for (int k = 0; k < n; ++k)
+                reap_job((int)(evs[k].data.u64 >> 32), (int)(evs[k].data.u64 & 0xffffffffu));
+        } while (n == 64);
+    }
+
+    // jobs with stages that have no pidfd still need polling
+    if (g_jobs.npolled > 0) {
+        for (int i = 0; i < g_jobs.used; ++i)
+            if (g_jobs.slots[i].active && !g_jobs.slots[i].done && g_jobs.slots[i].polled)
+                reap_job(i, -1);
+    }
+    job_events_flush();
+}
+
+void jobs_forked_child(void) {
+    if (g_jobs.epfd >= 0) close(g_jobs.epfd);
+    g_jobs.epfd = -1;
+    for (int i = 0; i < g_jobs.used; ++i) {
+        job_t *j = &g_jobs.slots[i];
+        if (!j->active || j->done) continue;
+        for (int k = 0; k < j->nprocs; ++k) {
+            if (j->procs[k].pidfd >= 0) close(j->procs[k].pidfd);
+            j->procs[k].pidfd = -1;
         }
+        j->polled = 0;
     }
+    g_jobs.npolled = 0;
+}
+
+static double ts_diff(const struct timespec *a, const struct timespec *b) {
+    return (double)(b->tv_sec - a->tv_sec) + (double)(b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static void print_cgstats(const cg_stats_t *st) {
+    out_printf("     psi cpu %.3fs mem %.3fs io %.3fs",
+           (double)st->cpu_some_us / 1e6, (double)st->mem_some_us / 1e6, (double)st->io_some_us / 1e6);
+    if (st->mem_peak >= 0) out_printf(" memory.peak %lldk", st->mem_peak / 1024);
+    out_printf("\n");
 }
 
 void print_jobs(void) {
@@ -38,11 +344,38 @@ void print_jobs(void) {
     reap_finished_jobs();
 
     int any = 0;
-    for (int i = 0; i < MAX_JOBS; ++i) {
-        if (g_jobs[i].active) {
+    for (int i = 0; i < g_jobs.used; ++i) {
+        job_t *j = &g_jobs.slots[i];
+        if (j->active && !j->done) {
             any = 1;
-            printf("[%d] Running  %s\n", g_jobs[i].pid, g_jobs[i].cmdline[0] ? g_jobs[i].cmdline : "(unknown)");
+            out_printf("[%d] Running  %s\n", j->pgid, j->cmdline && j->cmdline[0] ? j->cmdline : "(unknown)");
+            if (j->cg.fd >= 0) {
+                cg_stats_t st;
+                cg_read_stats(&j->cg, &st);
+                print_cgstats(&st);
+            }
         }
     }
-    if (!any) printf("(no background jobs)\n");
+    for (int i; (i = pop_done()) >= 0; ) {
+        job_t *j = &g_jobs.slots[i];
+        any = 1;
+        if (WIFSIGNALED(j->status))
+            out_printf("[%d] Killed(%d) %s\n", j->pgid, WTERMSIG(j->status), j->cmdline ? j->cmdline : "");
+        else
+            out_printf("[%d] Done(%d)  %s\n", j->pgid, WEXITSTATUS(j->status), j->cmdline ? j->cmdline : "");
+        out_printf("     " RUSAGE_FMT, RUSAGE_ARGS(&j->ru, ts_diff(&j->start, &j->end)));
+        if (j->has_cgstats) print_cgstats(&j->cgstats);
+        release_slot(i);
+    }
+    if (!any) out_printf("(no background jobs)\n");
+}
+
+void print_jobs_json(void) {
+    reap_finished_jobs();
+    for (int i = 0; i < g_jobs.used; ++i)
+        if (g_jobs.slots[i].active && !g_jobs.slots[i].done) job_print_json(&g_jobs.slots[i]);
+    for (int i; (i = pop_done()) >= 0; ) {
+        job_print_json(&g_jobs.slots[i]);
+        release_slot(i);
+    }
 }
@@ -1,21 +1,94 @@
 #pragma once
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <stdio.h>
+#include <time.h>
+#include "cgroup.h"
 
-#define MAX_JOBS 64
+// One process of a job (a pipeline stage)
+typedef struct {
+    pid_t pid;                 // 0 once reaped
+    int   pidfd;               // registered with the job epoll set, -1 if none
+} job_proc_t;
 
+// A background job: one process group holding every stage of a pipeline
 typedef struct {
-    pid_t pid;
-    int   active;              // 1 = running, 0 = finished/empty
-    char  cmdline[256];        
+    pid_t pgid;                // process group id (= pid of the first stage)
+    int   active;              // 1 = slot in use (running or done), 0 = empty
+    int   done;                // all stages reaped; kept until `jobs` reports it
+                               // or JOBS_DONE_MAX newer jobs have finished
+    int   status;              // wait status of the pipeline's last stage
+    struct rusage   ru;        // summed over reaped stages (maxrss: the largest)
+    struct timespec start, end;   // launch / reap time (CLOCK_MONOTONIC)
+    const char *cmdline;       // interned (strpool.h), shared with history
+    job_proc_t *procs;
+    int   nprocs;
+    int   nlive;               // stages not reaped yet
+    int   polled;              // 1 if some stage has no pidfd (waitid fallback)
+    int   next;                // free list link (inactive) / pgid hash chain (active)
+    int   done_next;           // next finished job, oldest first (done only)
+    cg_job_t   cg;             // the job's cgroup while it runs (fd -1: none)
+    cg_stats_t cgstats;        // read back from it when the job ends
+    int   has_cgstats;
 } job_t;
 
-extern job_t g_jobs[MAX_JOBS];
+// Growable job table: slots are recycled through a free list and looked up
+// by pgid through a chained hash, so no operation scans the whole table.
+typedef struct {
+    job_t *slots;
+    int    cap;                // allocated slots
+    int    used;               // slots ever handed out (<= cap)
+    int    nactive;
+    int    free_head;          // first recycled slot, -1 if none
+    int   *buckets;            // pgid hash heads, nbuckets is a power of two
+    int    nbuckets;
+    int    epfd;               // epoll over the jobs' pidfds
+    int    npolled;            // active jobs with polled stages
+    struct rusage reaped_ru;   // summed over every stage ever collected
+    int    done_head, done_tail;   // finished jobs not reported yet, oldest first
+    int    ndone;
+} job_table_t;
+
+// Finished jobs kept for `jobs` to report; when one more finishes, the
+// oldest is dropped unreported, so a shell nobody lists jobs in stays small
+#define JOBS_DONE_MAX 256
+
+extern job_table_t g_jobs;
+
+// Add a job made of the npids processes in group pgid (all already in it);
+// returns index or -1 on allocation failure
+int add_job(pid_t pgid, const pid_t *pids, int npids, const char *cmdline);
 
-// Add a job; returns index or -1 if full
-int add_job(pid_t pid, const char *cmdline);
+// Hand the job its cgroup; it is read back and removed when the job ends
+void job_attach_cgroup(int idx, cg_job_t cg);
 
-// Reap any finished background jobs (non-blocking)
+// Accumulate r into acc (times/counters summed, ru_maxrss maxed; a
+// ru_maxrss of -1 means unknown and stays so)
+void rusage_add(struct rusage *acc, const struct rusage *r);
+
+// Subtract r from acc (a later getrusage() snapshot); ru_maxrss is a
+// high-water mark and is left as it is
+void rusage_delta(struct rusage *acc, const struct rusage *r);
+
+// One-line summary: real/user/sys time, max RSS ("n/a" if unknown),
+// faults, context switches
+void print_rusage(FILE *f, const struct rusage *ru, double real_sec);
+
+// Reap any finished background jobs (non-blocking). Only jobs with a stage
+// whose pidfd became readable are touched; their group is drained with
+// waitid(P_PGID) so no stage is left behind as a zombie.
 void reap_finished_jobs(void);
 
 
+// In a forked child that runs shell code (a builtin stage): close the job
+// table's epoll fd and pidfds, which watch the parent's children, and stop
+// polling, so the child never reaps or reports the parent's jobs as ended
+// (`jobs` there shows them as they were at the fork)
+void jobs_forked_child(void);
+
+// List running jobs, then finished ones (oldest first) with their resource
+// usage; a finished job is shown once and then dropped
 void print_jobs(void);
+
+// Same jobs, one JSON object per line (`jobs --json`; see jobevents.h)
+void print_jobs_json(void);
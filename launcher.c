@@ -0,0 +1,323 @@
+#define _GNU_SOURCE     // close_range, posix_spawn_file_actions_addclosefrom_np, CPU_SET
+#include "launcher.h"
+#include "pathcache.h"
+#include "trace.h"
+#include "forksrv.h"
+#include "out.h"      // out_flush() before fork
+#include "jobs.h"     // jobs_forked_child()
+#include <spawn.h>
+#include <stdio_ext.h>     // __fpurge
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>        // sched_setaffinity
+#include <fcntl.h>
+#include <limits.h>       // PATH_MAX
+#include <dirent.h>     // fdaudit: /proc/self/fd
+#include <signal.h>
+#include <sys/syscall.h>
+#include <linux/sched.h>    // struct clone_args, CLONE_INTO_CGROUP
+
+extern char **environ;
+
+spawn_engine_t g_spawn_engine = SPAWN_FORK;
+int g_pipeline_barrier = 0;
+int g_fd_audit = 0;
+
+// posix_spawn_file_actions_addclosefrom_np() appeared in glibc 2.34
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+#define HAVE_ADDCLOSEFROM 1
+#endif
+
+static const char *const engine_names[] = {
+    [SPAWN_FORK]  = "fork",
+    [SPAWN_POSIX] = "posix",
+    [SPAWN_SERVER] = "server",
+};
+
+const char *spawn_engine_name(spawn_engine_t e) {
+    if ((unsigned)e < sizeof(engine_names) / sizeof(engine_names[0])) return engine_names[e];
+    return "?";
+}
+
+int spawn_engine_parse(const char *name) {
+    if (!name) return -1;
+    for (size_t i = 0; i < sizeof(engine_names) / sizeof(engine_names[0]); ++i)
+        if (strcmp(name, engine_names[i]) == 0) return (int)i;
+    return -1;
+}
+
+/* ---------- fork engine ---------- */
+
+// Close [lo, hi] in one syscall, or one by one on kernels without close_range
+static void close_fds(unsigned lo, unsigned hi) {
+    if (lo > hi) return;
+    if (syscall(SYS_close_range, lo, hi, 0) == 0) return;
+
+    long max = sysconf(_SC_OPEN_MAX);
+    if (max < 0 || max > 65536) max = 65536;
+    if (hi > (unsigned)max) hi = (unsigned)max;
+    for (unsigned fd = lo; fd <= hi; ++fd) close((int)fd);
+}
+
+// Park the child until the parent closes the barrier's write end
+static void wait_barrier(int fd) {
+    char c;
+    while (read(fd, &c, 1) < 0 && errno == EINTR) { }
+    close(fd);
+}
+
+// Child side of a launch into a cgroup that clone3() could not do for us
+static void join_cgroup(int dirfd) {
+    int fd = openat(dirfd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || write(fd, "0", 1) < 0) perror("cgroup.procs");
+    if (fd >= 0) close(fd);
+}
+
+// `shopt fdaudit on`: the fds without FD_CLOEXEC, i.e. what exec keeps
+static void audit_fds(const spawn_req_t *r) {
+    DIR *d = opendir("/proc/self/fd");
+    if (!d) { perror("fdaudit"); return; }
+
+    // one write per child, so concurrent stages do not interleave
+    char line[4096];
+    int n = snprintf(line, sizeof(line), "fdaudit: %d %.*s:", (int)getpid(), 256, r->file);
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        int fd = atoi(e->d_name), fl;
+        if (fd == dirfd(d) || (fl = fcntl(fd, F_GETFD)) < 0 || (fl & FD_CLOEXEC)) continue;
+
+        char link[64], target[PATH_MAX], item[PATH_MAX + 32];
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        ssize_t k = readlink(link, target, sizeof(target) - 1);
+        target[k > 0 ? k : 0] = '\0';
+        int len = snprintf(item, sizeof(item), " %d=%s%s", fd, target,
+                           fd > STDERR_FILENO ? " (leaked)" : "");
+        if ((size_t)n + (size_t)len >= sizeof(line)) break;    // whole entries only
+        memcpy(line + n, item, (size_t)len + 1);
+        n += len;
+    }
+    closedir(d);
+    fprintf(stderr, "%s\n", line);
+}
+
+// Job-control and child signals a launch must not inherit ignored or
+// blocked: exec keeps SIG_IGN and the mask, so ^C and ^\ could not stop
+// the command (the fork server ignores SIGINT and SIGQUIT itself)
+static const int g_reset_signals[] = { SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD };
+#define NRESET_SIGNALS (sizeof(g_reset_signals) / sizeof(g_reset_signals[0]))
+
+static void reset_signals(void) {
+    for (size_t i = 0; i < NRESET_SIGNALS; ++i) signal(g_reset_signals[i], SIG_DFL);
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+}
+
+void spawn_child_exec(const spawn_req_t *r) {
+    TRACE_DECL(t_child);
+    reset_signals();
+    if (r->cgroup_fd >= 0) join_cgroup(r->cgroup_fd);
+    if (r->setpgrp && setpgid(0, r->pgid) < 0) { perror("setpgid"); _exit(126); }
+    if (r->in  != STDIN_FILENO)  {
+        if (dup2(r->in,  STDIN_FILENO)  < 0) { perror("dup2 in");  _exit(126); }
+        close(r->in);
+    }
+    if (r->out != STDOUT_FILENO) {
+        if (dup2(r->out, STDOUT_FILENO) < 0) { perror("dup2 out"); _exit(126); }
+        close(r->out);
+    }
+    if (r->barrier_fd >= 0) {
+        // keep only the barrier so the write end held by siblings goes away
+        close_fds(STDERR_FILENO + 1, (unsigned)r->barrier_fd - 1);
+        close_fds((unsigned)r->barrier_fd + 1, ~0U);
+        wait_barrier(r->barrier_fd);
+    } else if (r->close_others) {
+        close_fds(STDERR_FILENO + 1, ~0U);
+    }
+    TRACE_SPAN("dup2", t_child);     // setpgid + fd wiring + closes
+    if (r->pin_cpu > 0) {
+        // before exec, so the program's first pages are touched on its node
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(r->pin_cpu - 1, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0) perror("sched_setaffinity");
+    }
+    if (g_fd_audit) audit_fds(r);
+    if (r->builtin) {
+        // drop whatever the shell had buffered and the parent's job
+        // watches, then run in this process
+        __fpurge(stdin);
+        __fpurge(stdout);
+        out_discard();
+        jobs_forked_child();
+        int rc = r->builtin(r->argv);
+        out_flush();
+        fflush(stdout);
+        _exit(rc & 0xff);
+    }
+    // exec itself can't be timed from here: mark the moment it starts
+    TRACE_MARK("execve");
+    execve(r->path, r->argv, environ);
+    if (errno == ENOEXEC) {
+        // no #! line: run it as a script, as execvp() would
+        int argc = 0;
+        while (r->argv[argc]) argc++;
+        char *sh_argv[argc + 2];
+        sh_argv[0] = "/bin/sh";
+        sh_argv[1] = (char *)r->path;
+        for (int i = 1; i <= argc; ++i) sh_argv[i + 1] = r->argv[i];
+        execve(sh_argv[0], sh_argv, environ);
+    }
+    int err = errno;
+    fprintf(stderr, "%s: %s\n", r->file, strerror(err));
+    _exit(err == ENOENT ? 127 : 126);
+}
+
+// fork() that starts the child in cgroup dirfd; -1 with ENOSYS etc. when
+// the kernel cannot (pre-5.7, or cgroup v1)
+static pid_t clone_into_cgroup(int dirfd) {
+    struct clone_args ca;
+    memset(&ca, 0, sizeof(ca));
+    ca.flags       = CLONE_INTO_CGROUP;
+    ca.exit_signal = SIGCHLD;
+    ca.cgroup      = (unsigned long long)dirfd;
+    return (pid_t)syscall(SYS_clone3, &ca, sizeof(ca));
+}
+
+static pid_t spawn_fork(const spawn_req_t *r) {
+    TRACE_DECL(t_fork);
+    spawn_req_t c = *r;
+    pid_t pid = -1;
+    if (r->cgroup_fd >= 0) {
+        pid = clone_into_cgroup(r->cgroup_fd);
+        if (pid == 0) c.cgroup_fd = -1;      // already there
+    }
+    if (r->cgroup_fd < 0 || pid < 0) pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+
+    if (pid == 0) spawn_child_exec(&c);
+    TRACE_SPAN("fork", t_fork);
+    return pid;
+}
+
+/* ---------- posix_spawn engine ---------- */
+
+// Translate the in/out wiring into file actions.
+// Returns 0 on success, an errno value if the actions could not be built.
+static int build_file_actions(posix_spawn_file_actions_t *fa, const spawn_req_t *r) {
+    int err = posix_spawn_file_actions_init(fa);
+    if (err) return err;
+
+    if (r->in != STDIN_FILENO) {
+        if ((err = posix_spawn_file_actions_adddup2(fa, r->in, STDIN_FILENO)))  goto FAIL;
+        if ((err = posix_spawn_file_actions_addclose(fa, r->in)))               goto FAIL;
+    }
+    if (r->out != STDOUT_FILENO) {
+        if ((err = posix_spawn_file_actions_adddup2(fa, r->out, STDOUT_FILENO))) goto FAIL;
+        if ((err = posix_spawn_file_actions_addclose(fa, r->out)))               goto FAIL;
+    }
+#ifdef HAVE_ADDCLOSEFROM
+    if (r->close_others &&
+        (err = posix_spawn_file_actions_addclosefrom_np(fa, STDERR_FILENO + 1)))  goto FAIL;
+#endif
+    return 0;
+
+FAIL:
+    posix_spawn_file_actions_destroy(fa);
+    return err;
+}
+
+// 1 if the request fits in posix_spawn file actions/attributes
+static int posix_can_express(const spawn_req_t *r) {
+    // dup2(in, 0) would clobber an `out` that lives on fd 0
+    if (r->out == STDIN_FILENO && r->in != STDIN_FILENO) return 0;
+    // a blocking read between wiring and exec has no file-action equivalent
+    if (r->barrier_fd >= 0) return 0;
+    // nor does pinning the child to a CPU or placing it in a cgroup
+    if (r->pin_cpu > 0 || r->cgroup_fd >= 0) return 0;
+    // the audit runs in the child between fork and exec
+    if (g_fd_audit) return 0;
+#ifndef HAVE_ADDCLOSEFROM
+    if (r->close_others) return 0;
+#endif
+    return 1;
+}
+
+static pid_t spawn_posix(const spawn_req_t *r) {
+    posix_spawn_file_actions_t fa;
+    int err = build_file_actions(&fa, r);
+    if (err) return spawn_fork(r);      // e.g. ENOMEM: let fork() try
+
+    // same signal state as spawn_child_exec() gives the other engines
+    posix_spawnattr_t attr, *ap = &attr;
+    if ((err = posix_spawnattr_init(&attr))) {
+        posix_spawn_file_actions_destroy(&fa);
+        return spawn_fork(r);
+    }
+    sigset_t def, none;
+    sigemptyset(&def);
+    sigemptyset(&none);
+    for (size_t i = 0; i < NRESET_SIGNALS; ++i) sigaddset(&def, g_reset_signals[i]);
+    posix_spawnattr_setsigdefault(&attr, &def);
+    posix_spawnattr_setsigmask(&attr, &none);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    if (r->setpgrp) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, r->pgid);
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    pid_t pid;
+    TRACE_DECL(t_spawn);
+    err = posix_spawn(&pid, r->path, &fa, ap, r->argv, environ);
+    TRACE_SPAN("posix_spawn", t_spawn);
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(ap);
+
+    // exec failures are the child's to report, with its own exit status
+    // (and a script without #! gets its /bin/sh retry there)
+    if (err == ENOSYS || err == ENOENT || err == EACCES || err == ENOEXEC) return spawn_fork(r);
+    if (err) {
+        fprintf(stderr, "%s: %s\n", r->file, strerror(err));
+        errno = err;
+        return -1;
+    }
+    return pid;
+}
+
+// Child of a command that is not in PATH: it fails on its own, so the
+// rest of a pipeline still runs
+static int not_found(char **argv) {
+    fprintf(stderr, "%s: command not found\n", argv[0]);
+    return 127;
+}
+
+pid_t spawn_process(const spawn_req_t *req) {
+    // nothing buffered may reach the child twice or after its output
+    out_flush();
+    fflush(stdout);
+    spawn_req_t r = *req;
+    if (!r.builtin && !r.path && !(r.path = path_lookup(r.file))) r.builtin = not_found;
+    if (r.builtin) {
+        pid_t pid = spawn_fork(&r);
+        if (pid > 0 && r.setpgrp) (void)setpgid(pid, r.pgid ? r.pgid : pid);
+        return pid;
+    }
+
+    pid_t pid = FORKSRV_UNAVAILABLE;
+    if (g_spawn_engine == SPAWN_SERVER) pid = forksrv_spawn(&r);
+    if (pid == FORKSRV_UNAVAILABLE)
+        pid = (g_spawn_engine == SPAWN_POSIX && posix_can_express(&r)) ? spawn_posix(&r) : spawn_fork(&r);
+
+    // Set the group from the parent too, so it exists before we return
+    // (the child may not have run yet). Fails harmlessly after exec.
+    if (pid > 0 && r.setpgrp) (void)setpgid(pid, r.pgid ? r.pgid : pid);
+    return pid;
+}
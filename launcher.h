@@ -0,0 +1,54 @@
+#pragma once
+#include <sys/types.h>
+
+// Process launch engines (selected with `shopt spawn <name>`)
+typedef enum {
+    SPAWN_FORK = 0,     // fork() + dup2() + execve() in the child
+    SPAWN_POSIX,        // posix_spawn() with file actions; no page-table copy
+    SPAWN_SERVER,       // ask the resident fork server (forksrv.c) to launch
+} spawn_engine_t;
+
+extern spawn_engine_t g_spawn_engine;
+
+// Start pipeline stages together behind a barrier (`shopt barrier on`)
+extern int g_pipeline_barrier;
+
+// Each child lists on stderr the fds it keeps across exec (`shopt fdaudit
+// on`); anything above 2 is a leak. Forces the fork engine.
+extern int g_fd_audit;
+
+// What the child should look like
+typedef struct {
+    const char *file;   // program name (argv[0]), used in messages
+    const char *path;   // resolved executable; NULL = look file up in the hash table
+    char      **argv;   // NULL-terminated argv vector
+    int         in;     // fd to use as STDIN  (or STDIN_FILENO)
+    int         out;    // fd to use as STDOUT (or STDOUT_FILENO)
+    int         close_others;   // child closes every fd above STDERR_FILENO
+    int         barrier_fd;     // read end of a launch barrier pipe (-1 = none);
+                                // child waits for EOF before exec. Implies close_others.
+    int         setpgrp;        // move the child into process group pgid
+    pid_t       pgid;           // 0 = child leads a new group
+    int       (*builtin)(char **argv);  // run this in the child instead of
+                                        // exec'ing path (forces the fork engine)
+    int         pin_cpu;        // 1 + CPU the child is pinned to before exec
+                                // (0 = inherit the shell's affinity)
+    int         cgroup_fd;      // cgroup v2 directory to start in (-1 = the
+                                // shell's); see cgroup.h
+} spawn_req_t;
+
+// Start a child process described by req using g_spawn_engine.
+// Falls back to fork() when the selected engine cannot express the request.
+// A name that is not in PATH still gets a child, which reports it and exits
+// 127, as does one whose execve() fails (126 unless ENOENT).
+// Returns the child's pid, or -1 on failure (message already printed).
+// Does not close req->in / req->out in the parent.
+pid_t spawn_process(const spawn_req_t *req);
+
+// Child side of a launch: wire fds, join the group, wait on the barrier and
+// execve(). Never returns. Shared by the fork engine and the fork server.
+void spawn_child_exec(const spawn_req_t *r) __attribute__((noreturn));
+
+// Engine name <-> value; spawn_engine_parse returns -1 on unknown name
+const char *spawn_engine_name(spawn_engine_t e);
+int spawn_engine_parse(const char *name);
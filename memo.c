@@ -0,0 +1,205 @@
+#include "memo.h"
+#include "pathcache.h"
+#include "zcopy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MEMO_MAGIC "SHMEMO1"
+
+typedef struct {
+    char     magic[8];
+    uint64_t key;       // guards against a renamed or foreign file
+    int32_t  status;
+    uint32_t pad;
+    uint64_t len;       // stdout bytes that follow the header
+} memo_hdr_t;
+
+char   g_memo_env[256] = "PATH:LANG:LC_ALL:PKG_CONFIG_PATH";
+size_t g_memo_max      = 64 << 20;
+
+static char g_dir[PATH_MAX];
+static char g_tmp[PATH_MAX + 32];   // record in progress (memo_begin)
+
+// FNV-1a, 64-bit
+static uint64_t fnv(uint64_t h, const void *p, size_t n) {
+    const unsigned char *s = p;
+    while (n--) { h ^= *s++; h *= 0x100000001b3ULL; }
+    return h;
+}
+
+static const char *cache_dir(void) {
+    if (g_dir[0]) return g_dir;
+    const char *xdg = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+    char base[PATH_MAX];
+    int n;
+    if (xdg && *xdg)        n = snprintf(base, sizeof(base), "%s", xdg);
+    else if (home && *home) n = snprintf(base, sizeof(base), "%s/.cache", home);
+    else return NULL;
+    if (n < 0 || (size_t)n >= sizeof(base)) return NULL;
+    (void)mkdir(base, 0700);
+    n = snprintf(g_dir, sizeof(g_dir), "%s/shell-memo", base);
+    if (n < 0 || (size_t)n >= sizeof(g_dir)) { g_dir[0] = '\0'; return NULL; }
+    if (mkdir(g_dir, 0700) < 0 && errno != EEXIST) { g_dir[0] = '\0'; return NULL; }
+    return g_dir;
+}
+
+static void entry_path(char *buf, size_t n, const memo_key_t *k) {
+    snprintf(buf, n, "%s/%016llx.memo", g_dir, (unsigned long long)k->hash);
+}
+
+int memo_key(memo_key_t *k, char **argv, const char *in_path) {
+    if (!cache_dir()) return -1;
+    const char *bin = path_lookup(argv[0]);
+    struct stat st;
+    if (!bin || stat(bin, &st) < 0) return -1;
+
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (char **a = argv; *a; ++a) h = fnv(h, *a, strlen(*a) + 1);
+    h = fnv(h, &st.st_dev, sizeof(st.st_dev));
+    h = fnv(h, &st.st_ino, sizeof(st.st_ino));
+    h = fnv(h, &st.st_size, sizeof(st.st_size));
+    h = fnv(h, &st.st_mtim, sizeof(st.st_mtim));
+
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) return -1;
+    h = fnv(h, cwd, strlen(cwd) + 1);
+
+    // selected environment: name=value, or name alone when unset
+    char names[sizeof(g_memo_env)];
+    snprintf(names, sizeof(names), "%s", g_memo_env);
+    char *save;
+    for (char *v = strtok_r(names, ":", &save); v; v = strtok_r(NULL, ":", &save)) {
+        const char *val = getenv(v);
+        h = fnv(h, v, strlen(v) + 1);
+        if (val) h = fnv(h, val, strlen(val) + 1);
+    }
+
+    if (in_path) {
+        int fd = open(in_path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        if (st.st_size > 0) {
+            void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m == MAP_FAILED) { close(fd); return -1; }
+            h = fnv(h, m, (size_t)st.st_size);
+            munmap(m, (size_t)st.st_size);
+        }
+        close(fd);
+    }
+    k->hash = h;
+    return 0;
+}
+
+int memo_replay(const memo_key_t *k, int out, int *status) {
+    char path[PATH_MAX + 32];
+    entry_path(path, sizeof(path), k);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    memo_hdr_t h;
+    struct stat st;
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, MEMO_MAGIC, 8) != 0 ||
+        h.key != k->hash || fstat(fd, &st) < 0 || (uint64_t)st.st_size != sizeof(h) + h.len) {
+        close(fd);
+        unlink(path);
+        return 0;
+    }
+    (void)futimens(fd, NULL);   // recently used
+    if (lseek(fd, sizeof(h), SEEK_SET) < 0 || zc_copy(fd, out) < 0) {
+        if (errno != EPIPE) perror("cached");
+    }
+    close(fd);
+    *status = h.status;
+    return 1;
+}
+
+int memo_begin(void) {
+    static unsigned seq;
+    snprintf(g_tmp, sizeof(g_tmp), "%s/.tmp.%d.%u", g_dir, (int)getpid(), seq++);
+    int fd = open(g_tmp, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    // the command writes after the header, which is filled in at the end
+    if (lseek(fd, sizeof(memo_hdr_t), SEEK_SET) < 0) {
+        close(fd);
+        unlink(g_tmp);
+        return -1;
+    }
+    return fd;
+}
+
+typedef struct {
+    char   name[32];
+    time_t mtime;
+    off_t  size;
+} memo_ent_t;
+
+static int cmp_mtime(const void *a, const void *b) {
+    const memo_ent_t *x = a, *y = b;
+    return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+// Drop the least recently used entries until the directory fits g_memo_max
+static void evict(void) {
+    DIR *d = opendir(g_dir);
+    if (!d) return;
+    memo_ent_t *v = NULL;
+    size_t n = 0, cap = 0;
+    off_t total = 0;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        size_t len = strlen(e->d_name);
+        if (len < 5 || len >= sizeof(v->name) || strcmp(e->d_name + len - 5, ".memo") != 0) continue;
+        struct stat st;
+        if (fstatat(dirfd(d), e->d_name, &st, 0) < 0) continue;
+        if (n == cap) {
+            memo_ent_t *nv = realloc(v, sizeof(*v) * (cap = cap ? cap * 2 : 64));
+            if (!nv) break;
+            v = nv;
+        }
+        memcpy(v[n].name, e->d_name, len + 1);     // len checked above
+        v[n].mtime = st.st_mtime;
+        v[n].size  = st.st_size;
+        total += st.st_size;
+        n++;
+    }
+    if ((size_t)total > g_memo_max) {
+        qsort(v, n, sizeof(*v), cmp_mtime);
+        for (size_t i = 0; i < n && (size_t)total > g_memo_max; ++i)
+            if (unlinkat(dirfd(d), v[i].name, 0) == 0) total -= v[i].size;
+    }
+    free(v);
+    closedir(d);
+}
+
+void memo_finish(const memo_key_t *k, int fd, int status, int out) {
+    off_t end = lseek(fd, 0, SEEK_END);
+    memo_hdr_t h = { .magic = MEMO_MAGIC, .key = k->hash, .status = status };
+    h.len = end > (off_t)sizeof(h) ? (uint64_t)end - sizeof(h) : 0;
+
+    // hand the output over first: the caller is waiting for it
+    if (lseek(fd, sizeof(h), SEEK_SET) < 0 || zc_copy(fd, out) < 0) {
+        if (errno != EPIPE) perror("cached");
+    }
+
+    char path[PATH_MAX + 32];
+    entry_path(path, sizeof(path), k);
+    // 126/127: the binary could not run, which is no result to replay
+    if (status < 126 && pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+        rename(g_tmp, path) == 0) {
+        close(fd);
+        evict();
+        return;
+    }
+    close(fd);
+    unlink(g_tmp);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Memo cache for `cached cmd args...`: the stdout and exit status of a
+// deterministic command are stored on disk ($XDG_CACHE_HOME/shell-memo or
+// ~/.cache/shell-memo) and replayed without forking when the same command
+// runs again. The key covers argv, the cwd, the resolved binary's device,
+// inode, size and mtime, the variables in `shopt memoenv` and the contents
+// of the `<` file. stderr is not recorded. Entries beyond `shopt memosize`
+// bytes are evicted least recently used first.
+
+typedef struct {
+    uint64_t hash;
+} memo_key_t;
+
+extern char   g_memo_env[256];  // colon-separated variable names
+extern size_t g_memo_max;       // bytes kept on disk
+
+// Build the key; -1 if the command cannot be memoized (not found, input
+// unreadable, no cache directory)
+int memo_key(memo_key_t *k, char **argv, const char *in_path);
+
+// Write a stored result to out and set *status. Returns 1 on a hit, 0 on
+// a miss.
+int memo_replay(const memo_key_t *k, int out, int *status);
+
+// Miss path: returns an fd to use as the command's stdout (-1: do not
+// record), then memo_finish() stores the result and copies it to out.
+// Results of commands that could not run (126, 127) or were killed by a
+// signal (status >= 128) are not kept.
+int  memo_begin(void);
+void memo_finish(const memo_key_t *k, int fd, int status, int out);
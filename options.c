@@ -0,0 +1,228 @@
+#include "options.h"
+#include "launcher.h"
+#include "forksrv.h"
+#include "pipebuf.h"
+#include "affinity.h"
+#include "redircache.h"
+#include "uring.h"
+#include "memo.h"
+#include "jobevents.h"
+#include "cgroup.h"
+#include "plan.h"
+#include "histfile.h"
+#include "remote.h"
+#include "out.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    const char *help;
+    int  (*set)(const char *value);     // 0 on success, -1 on bad value
+    void (*show)(char *buf, size_t n);
+} shopt_t;
+
+/* ---------- spawn ---------- */
+
+static int set_spawn(const char *v) {
+    int e = spawn_engine_parse(v);
+    if (e < 0) return -1;
+    // start the server now, while the shell is still small
+    if (e == SPAWN_SERVER && forksrv_start() < 0) return -1;
+    g_spawn_engine = (spawn_engine_t)e;
+    return 0;
+}
+static void show_spawn(char *buf, size_t n) {
+    snprintf(buf, n, "%s", spawn_engine_name(g_spawn_engine));
+}
+
+/* ---------- barrier ---------- */
+
+static int parse_bool(const char *v) {
+    if (strcmp(v, "on")  == 0 || strcmp(v, "1") == 0) return 1;
+    if (strcmp(v, "off") == 0 || strcmp(v, "0") == 0) return 0;
+    return -1;
+}
+
+static int set_barrier(const char *v) {
+    int b = parse_bool(v);
+    if (b < 0) return -1;
+    g_pipeline_barrier = b;
+    return 0;
+}
+static void show_barrier(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_pipeline_barrier ? "on" : "off");
+}
+
+/* ---------- fdaudit ---------- */
+
+static int set_fdaudit(const char *v) {
+    int b = parse_bool(v);
+    if (b < 0) return -1;
+    g_fd_audit = b;
+    return 0;
+}
+static void show_fdaudit(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_fd_audit ? "on" : "off");
+}
+
+/* ---------- pipesz / pipepacket ---------- */
+
+static int set_pipesz(const char *v) {
+    return pipe_size_parse(v, &g_pipe_size);
+}
+static void show_pipesz(char *buf, size_t n) {
+    if (g_pipe_size) snprintf(buf, n, "%zu", g_pipe_size);
+    else             snprintf(buf, n, "default");
+}
+
+static int set_pipepacket(const char *v) {
+    int b = parse_bool(v);
+    if (b < 0) return -1;
+    g_pipe_packet = b;
+    return 0;
+}
+static void show_pipepacket(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_pipe_packet ? "on" : "off");
+}
+
+/* ---------- redircache ---------- */
+
+static int set_redircache(const char *v) {
+    int b = parse_bool(v);
+    if (b < 0) return -1;
+    if (!b) redir_cache_clear();
+    g_redir_cache = b;
+    return 0;
+}
+static void show_redircache(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_redir_cache ? "on" : "off");
+}
+
+/* ---------- plancache ---------- */
+
+static int set_plancache(const char *v) {
+    int b = parse_bool(v);
+    if (b < 0) return -1;
+    if (!b) plan_cache_clear();
+    g_plan_cache = b;
+    return 0;
+}
+static void show_plancache(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_plan_cache ? "on" : "off");
+}
+
+/* ---------- remotecompress / remotepersist ---------- */
+
+static int set_remotecompress(const char *v) {
+    int b = parse_bool(v);
+    if (b < 0) return -1;
+    g_remote_compress = b;
+    return 0;
+}
+static void show_remotecompress(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_remote_compress ? "on" : "off");
+}
+
+static int set_remotepersist(const char *v) {
+    char *end;
+    long s = strtol(v, &end, 10);
+    if (end == v || *end || s < 0 || s > 86400) return -1;
+    g_remote_persist = (int)s;
+    return 0;
+}
+static void show_remotepersist(char *buf, size_t n) {
+    snprintf(buf, n, "%d", g_remote_persist);
+}
+
+/* ---------- wait ---------- */
+
+static int set_wait(const char *v) {
+    if (strcmp(v, "classic") == 0) { g_wait_uring = 0; return 0; }
+    if (strcmp(v, "uring") != 0 || uring_init() < 0) return -1;
+    if (!uring_can_wait()) {
+        fprintf(stderr, "shopt: wait: io_uring cannot wait for children here (IORING_OP_WAITID needs Linux 6.7)\n");
+        return -1;
+    }
+    g_wait_uring = 1;
+    return 0;
+}
+static void show_wait(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_wait_uring ? "uring" : "classic");
+}
+
+/* ---------- memoenv / memosize ---------- */
+
+static int set_memoenv(const char *v) {
+    if (strlen(v) >= sizeof(g_memo_env)) return -1;
+    snprintf(g_memo_env, sizeof(g_memo_env), "%s", v);
+    return 0;
+}
+static void show_memoenv(char *buf, size_t n) {
+    snprintf(buf, n, "%s", g_memo_env);
+}
+
+static int set_memosize(const char *v) {
+    return pipe_size_parse(v, &g_memo_max);
+}
+static void show_memosize(char *buf, size_t n) {
+    snprintf(buf, n, "%zu", g_memo_max);
+}
+
+static const shopt_t g_shopts[] = {
+    { "spawn",   "launch engine: fork | posix | server",      set_spawn,   show_spawn   },
+    { "barrier", "start pipeline stages together: on | off",  set_barrier, show_barrier },
+    { "fdaudit", "children list the fds they inherit: on | off", set_fdaudit, show_fdaudit },
+    { "pipesz",  "pipeline pipe size: bytes[k|M] | 0",        set_pipesz,  show_pipesz  },
+    { "pipepacket", "O_DIRECT (packet mode) pipes: on | off", set_pipepacket, show_pipepacket },
+    { "redircache", "keep redirection targets open: on | off", set_redircache, show_redircache },
+    { "plancache", "reuse resolved pipeline stages: on | off", set_plancache, show_plancache },
+    { "wait",    "reap/open engine: classic | uring",         set_wait,    show_wait    },
+    { "memoenv", "variables in the `cached` key: A:B:...",   set_memoenv, show_memoenv },
+    { "memosize", "`cached` results kept on disk: bytes[k|M]", set_memosize, show_memosize },
+    { "histfile", "shared history/job log: off | FILE",        histfile_open, histfile_show },
+    { "jobevents", "NDJSON job events: off | fd:N | unix:PATH | FILE", job_events_open, job_events_show },
+    { "cgroup",  "cgroup v2 per job: off | bg | all",          cgroup_set_mode, cgroup_show_mode },
+    { "cgcpu",   "job cpu.max: max | N%",                     cgroup_set_cpu,  cgroup_show_cpu  },
+    { "cgmem",   "job memory.max: max | bytes[k|M|G]",        cgroup_set_mem,  cgroup_show_mem  },
+    { "cgio",    "job io.weight: 1..10000",                   cgroup_set_io,   cgroup_show_io   },
+    { "remotecompress", "compress `@host` stage streams: on | off", set_remotecompress, show_remotecompress },
+    { "remotepersist", "keep `@host` connections for SECONDS",     set_remotepersist,  show_remotepersist  },
+    { "affinity", "stage CPUs: off | compact | spread | cpulist", affinity_set, affinity_show },
+};
+#define NSHOPTS (sizeof(g_shopts) / sizeof(g_shopts[0]))
+
+static const shopt_t *find_shopt(const char *name) {
+    for (size_t i = 0; i < NSHOPTS; ++i)
+        if (strcmp(g_shopts[i].name, name) == 0) return &g_shopts[i];
+    return NULL;
+}
+
+static void print_shopt(const shopt_t *o) {
+    char val[128];
+    o->show(val, sizeof(val));
+    out_printf("%-12s %-10s # %s\n", o->name, val, o->help);
+}
+
+int builtin_shopt(char **argv) {
+    if (!argv[1]) {
+        for (size_t i = 0; i < NSHOPTS; ++i) print_shopt(&g_shopts[i]);
+        return 0;
+    }
+
+    const shopt_t *o = find_shopt(argv[1]);
+    if (!o) {
+        fprintf(stderr, "shopt: %s: unknown option\n", argv[1]);
+        return 1;
+    }
+    if (!argv[2]) {
+        print_shopt(o);
+        return 0;
+    }
+    if (o->set(argv[2]) < 0) {
+        fprintf(stderr, "shopt: %s: invalid value '%s'\n", o->name, argv[2]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Shell tunables, inspected and changed with the `shopt` builtin:
+//   shopt                 list all options and their values
+//   shopt <name>          print one option
+//   shopt <name> <value>  change it
+int builtin_shopt(char **argv);
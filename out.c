@@ -0,0 +1,118 @@
+#define _GNU_SOURCE     // F_GETPIPE_SZ
+#include "out.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+
+#define OUT_CHUNK   4096
+#define OUT_NCHUNK  64
+
+static char  *g_chunk[OUT_NCHUNK];      // allocated on first use, kept
+static size_t g_used[OUT_NCHUNK];
+static int    g_cur;                    // chunk being filled
+static size_t g_pending;                // bytes in the batch
+static size_t g_limit;                  // flush threshold for this batch
+
+// First byte of a batch: earlier stdio output goes first, and the
+// threshold follows what fd 1 is right now (builtin_run() may have
+// pointed it at a pipe or file)
+static void batch_start(void) {
+    fflush(stdout);
+    g_limit = (size_t)OUT_CHUNK * OUT_NCHUNK;
+    struct stat st;
+    if (fstat(STDOUT_FILENO, &st) < 0) return;
+    if (S_ISCHR(st.st_mode) && isatty(STDOUT_FILENO)) {
+        g_limit = OUT_CHUNK;
+    } else if (S_ISFIFO(st.st_mode)) {
+        int sz = fcntl(STDOUT_FILENO, F_GETPIPE_SZ);
+        if (sz > 0 && (size_t)sz < g_limit) g_limit = (size_t)sz;
+    }
+}
+
+static void write_all(struct iovec *iov, int n) {
+    while (n > 0) {
+        ssize_t w = writev(STDOUT_FILENO, iov, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return;     // EPIPE and the like: the reader is gone
+        }
+        while (n > 0 && (size_t)w >= iov->iov_len) { w -= (ssize_t)iov->iov_len; iov++; n--; }
+        if (n > 0) { iov->iov_base = (char *)iov->iov_base + w; iov->iov_len -= (size_t)w; }
+    }
+}
+
+void out_flush(void) {
+    if (g_pending == 0) return;
+    struct iovec iov[OUT_NCHUNK];
+    int n = 0;
+    for (int i = 0; i <= g_cur && i < OUT_NCHUNK; i++) {
+        if (g_used[i]) iov[n++] = (struct iovec){ .iov_base = g_chunk[i], .iov_len = g_used[i] };
+        g_used[i] = 0;
+    }
+    write_all(iov, n);
+    g_cur = 0;
+    g_pending = 0;
+}
+
+void out_discard(void) {
+    memset(g_used, 0, sizeof(g_used));
+    g_cur = 0;
+    g_pending = 0;
+}
+
+void out_write(const void *p, size_t n) {
+    const char *s = p;
+    while (n > 0) {
+        if (g_pending == 0) batch_start();
+        if (!g_chunk[g_cur] && !(g_chunk[g_cur] = malloc(OUT_CHUNK))) {
+            // no memory for a chunk: send what we have, then this unbuffered
+            out_flush();
+            struct iovec v = { .iov_base = (void *)s, .iov_len = n };
+            write_all(&v, 1);
+            return;
+        }
+        size_t k = OUT_CHUNK - g_used[g_cur];
+        if (k > n) k = n;
+        memcpy(g_chunk[g_cur] + g_used[g_cur], s, k);
+        g_used[g_cur] += k;
+        g_pending += k;
+        s += k;
+        n -= k;
+        if (g_used[g_cur] == OUT_CHUNK && ++g_cur == OUT_NCHUNK) out_flush();
+        else if (g_pending >= g_limit) out_flush();
+    }
+}
+
+void out_putc(int c) {
+    char ch = (char)c;
+    out_write(&ch, 1);
+}
+
+void out_puts(const char *s) {
+    out_write(s, strlen(s));
+    out_putc('\n');
+}
+
+int out_printf(const char *fmt, ...) {
+    char buf[1024], *p = buf;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return n;
+    if ((size_t)n >= sizeof(buf)) {
+        if (!(p = malloc((size_t)n + 1))) return -1;
+        va_start(ap, fmt);
+        vsnprintf(p, (size_t)n + 1, fmt, ap);
+        va_end(ap);
+    }
+    out_write(p, (size_t)n);
+    if (p != buf) free(p);
+    return n;
+}
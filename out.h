@@ -0,0 +1,20 @@
+#pragma once
+#include <stddef.h>
+
+// Output layer for builtins. Text is collected in 4 KiB chunks and sent to
+// fd 1 with one writev() when the builtin returns (builtin_run()), before
+// any fork (spawn_process()), or once the batch reaches a limit picked
+// when its first byte arrives: the pipe's capacity for a pipe, 4 KiB for a
+// terminal, 256 KiB otherwise. Pending stdio output on stdout is flushed
+// ahead of a batch, so the two can be mixed in order.
+
+int  out_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void out_write(const void *p, size_t n);
+void out_putc(int c);
+void out_puts(const char *s);       // s and a newline, like puts()
+
+// Send everything pending (a no-op without pending output)
+void out_flush(void);
+
+// Forked child: drop what the parent had pending
+void out_discard(void);
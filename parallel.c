@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+#include "parallel.h"
+#include "executor.h"   // launch_command()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+typedef struct {
+    pid_t pid;
+    int   pidfd;        // -1: no pidfd, waited for by pid
+} runner_t;
+
+// argv of the template with `{}` (or a trailing slot) replaced by input
+static char **build_argv(char **tmpl, int ntmpl, char *input) {
+    char **v = malloc(sizeof(char *) * (size_t)(ntmpl + 2));
+    if (!v) return NULL;
+    int n = 0, substituted = 0;
+    for (int i = 0; i < ntmpl; ++i) {
+        if (strcmp(tmpl[i], "{}") == 0) { v[n++] = input; substituted = 1; }
+        else v[n++] = tmpl[i];
+    }
+    if (!substituted) v[n++] = input;
+    v[n] = NULL;
+    return v;
+}
+
+// Inputs from stdin, one per line (returned array and lines are malloc'ed).
+// Reads fd 0 directly: stdio's stdin buffer belongs to the shell's reader.
+static char **read_inputs(int *count) {
+    char **v = NULL, *buf = NULL;
+    size_t cap = 0, n = 0, len = 0, bcap = 0;
+
+    for (;;) {
+        if (len == bcap) {
+            bcap = bcap ? bcap * 2 : 4096;
+            char *nb = realloc(buf, bcap);
+            if (!nb) break;
+            buf = nb;
+        }
+        ssize_t r = read(STDIN_FILENO, buf + len, bcap - len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        len += (size_t)r;
+    }
+
+    for (size_t i = 0; i < len; ) {
+        char *nl = memchr(buf + i, '\n', len - i);
+        size_t end = nl ? (size_t)(nl - buf) : len;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            char **nv = realloc(v, sizeof(char *) * cap);
+            if (!nv) break;
+            v = nv;
+        }
+        if (!(v[n] = strndup(buf + i, end - i))) break;
+        n++;
+        i = end + 1;
+    }
+    free(buf);
+    *count = (int)n;
+    return v;
+}
+
+// Reap one finished runner (blocking); returns its slot
+static int wait_any(runner_t *run, int nrun, int *failed) {
+    struct pollfd pfd[nrun];
+    int npfd = 0;
+    for (int k = 0; k < nrun; ++k) {
+        if (run[k].pidfd < 0) continue;
+        pfd[npfd].fd = run[k].pidfd;
+        pfd[npfd].events = POLLIN;
+        npfd++;
+    }
+
+    int slot = 0;       // runners without a pidfd: just wait for the oldest
+    if (npfd > 0) {
+        while (poll(pfd, (nfds_t)npfd, -1) < 0 && errno == EINTR) { }
+        for (int k = 0; k < nrun; ++k) {
+            int ready = 0;
+            for (int p = 0; p < npfd; ++p)
+                if (pfd[p].fd == run[k].pidfd && pfd[p].revents) ready = 1;
+            if (ready) { slot = k; break; }
+        }
+    }
+
+    int status;
+    while (waitpid(run[slot].pid, &status, 0) < 0 && errno == EINTR) { }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) *failed = 1;
+    if (run[slot].pidfd >= 0) close(run[slot].pidfd);
+    return slot;
+}
+
+int builtin_parallel(char **argv) {
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int i = 1;
+    if (argv[i] && strncmp(argv[i], "-j", 2) == 0) {
+        const char *n = argv[i][2] ? argv[i] + 2 : argv[++i];
+        if (!n || (jobs = strtol(n, NULL, 10)) < 1) {
+            fprintf(stderr, "parallel: -j needs a positive number\n");
+            return 1;
+        }
+        i++;
+    }
+    if (jobs < 1) jobs = 1;
+
+    char **tmpl = &argv[i];
+    int ntmpl = 0;
+    while (tmpl[ntmpl] && strcmp(tmpl[ntmpl], ":::") != 0) ntmpl++;
+    if (ntmpl == 0) {
+        fprintf(stderr, "usage: parallel [-j N] cmd [args...] [::: input...]\n");
+        return 1;
+    }
+
+    char **inputs, **owned = NULL;
+    int ninputs = 0;
+    if (tmpl[ntmpl]) {
+        inputs = &tmpl[ntmpl + 1];
+        while (inputs[ninputs]) ninputs++;
+    } else {
+        inputs = owned = read_inputs(&ninputs);
+    }
+
+    if (jobs > ninputs) jobs = ninputs > 0 ? ninputs : 1;
+    runner_t *run = malloc(sizeof(runner_t) * (size_t)jobs);
+    if (!run) { perror("parallel"); return 1; }
+
+    int nrun = 0, failed = 0;
+    for (int next = 0; next < ninputs || nrun > 0; ) {
+        if (next < ninputs && nrun < jobs) {
+            char **v = build_argv(tmpl, ntmpl, inputs[next++]);
+            if (!v) { failed = 1; continue; }
+            pid_t pid = launch_command(v[0], v, STDIN_FILENO, STDOUT_FILENO, 0);
+            free(v);
+            if (pid < 0) { failed = 1; continue; }
+            run[nrun].pid   = pid;
+            run[nrun].pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+            nrun++;
+            continue;
+        }
+        // full (or out of inputs): start the next one as soon as any exits
+        int slot = wait_any(run, nrun, &failed);
+        run[slot] = run[--nrun];
+    }
+
+    free(run);
+    if (owned) {
+        for (int k = 0; k < ninputs; ++k) free(owned[k]);
+        free(owned);
+    }
+    return failed;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// `parallel` builtin: run one command per input, keeping N running at once
+//
+//     parallel [-j N] cmd [args...] ::: input...
+//     parallel [-j N] cmd [args...]            (inputs are stdin lines)
+//
+// Each input is appended to the argv, or substituted for every `{}` word.
+// N defaults to the number of online CPUs. Returns 0 if every run exited 0.
+int builtin_parallel(char **argv);
@@ -0,0 +1,149 @@
+#include "pathcache.h"
+#include "out.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#define PATHCACHE_BUCKETS 64
+
+typedef struct path_entry {
+    char              *name;
+    char              *path;
+    unsigned           hits;
+    struct path_entry *next;
+} path_entry_t;
+
+static path_entry_t *g_buckets[PATHCACHE_BUCKETS];
+static char         *g_cached_PATH;     // PATH the table was built against
+static char          g_uncached[PATH_MAX];
+static unsigned      g_generation;      // bumped whenever entries are dropped
+
+// FNV-1a
+static unsigned hash_name(const char *s) {
+    unsigned h = 2166136261u;
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h % PATHCACHE_BUCKETS;
+}
+
+static int is_executable_file(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+}
+
+// Walk PATH like execvp would; writes the hit into buf.
+static int search_path(const char *cmd, char *buf, size_t n) {
+    const char *p = getenv("PATH");
+    if (!p) p = "/bin:/usr/bin";
+
+    while (1) {
+        const char *end = strchr(p, ':');
+        size_t dlen = end ? (size_t)(end - p) : strlen(p);
+        // empty component means the current directory
+        int len = dlen ? snprintf(buf, n, "%.*s/%s", (int)dlen, p, cmd)
+                       : snprintf(buf, n, "%s", cmd);
+        if (len > 0 && (size_t)len < n && is_executable_file(buf)) return 0;
+        if (!end) break;
+        p = end + 1;
+    }
+    return -1;
+}
+
+static void free_entry(path_entry_t *e) {
+    free(e->name);
+    free(e->path);
+    free(e);
+}
+
+void path_cache_clear(void) {
+    for (int b = 0; b < PATHCACHE_BUCKETS; ++b) {
+        path_entry_t *e = g_buckets[b];
+        while (e) { path_entry_t *nx = e->next; free_entry(e); e = nx; }
+        g_buckets[b] = NULL;
+    }
+    g_generation++;
+}
+
+// Drop the whole table if PATH is not what it was built against
+static void check_PATH(void) {
+    const char *cur = getenv("PATH");
+    if (!cur) cur = "";
+    if (g_cached_PATH && strcmp(g_cached_PATH, cur) == 0) return;
+
+    path_cache_clear();
+    free(g_cached_PATH);
+    g_cached_PATH = strdup(cur);
+}
+
+unsigned path_cache_generation(void) {
+    check_PATH();
+    return g_generation;
+}
+
+const char *path_lookup(const char *cmd) {
+    if (!cmd || !*cmd) return NULL;
+    if (strchr(cmd, '/')) return cmd;
+
+    check_PATH();
+
+    unsigned b = hash_name(cmd);
+    path_entry_t **pp = &g_buckets[b];
+    for (path_entry_t *e = *pp; e; pp = &e->next, e = e->next) {
+        if (strcmp(e->name, cmd) != 0) continue;
+        if (access(e->path, X_OK) == 0) {
+            e->hits++;
+            return e->path;
+        }
+        // stale: binary moved or removed, resolve again below
+        *pp = e->next;
+        free_entry(e);
+        g_generation++;
+        break;
+    }
+
+    if (search_path(cmd, g_uncached, sizeof(g_uncached)) < 0) return NULL;
+    // relative hits (from "." or empty PATH entries) depend on cwd; don't cache
+    if (g_uncached[0] != '/') return g_uncached;
+
+    path_entry_t *e = malloc(sizeof(*e));
+    if (!e) return g_uncached;
+    e->name = strdup(cmd);
+    e->path = strdup(g_uncached);
+    if (!e->name || !e->path) { free_entry(e); return g_uncached; }
+    e->hits = 1;
+    e->next = g_buckets[b];
+    g_buckets[b] = e;
+    return e->path;
+}
+
+int builtin_hash(char **argv) {
+    if (argv[1] && strcmp(argv[1], "-r") == 0) {
+        path_cache_clear();
+        return 0;
+    }
+
+    if (argv[1]) {
+        int rc = 0;
+        for (int i = 1; argv[i]; ++i) {
+            if (!path_lookup(argv[i])) {
+                fprintf(stderr, "hash: %s: not found\n", argv[i]);
+                rc = 1;
+            }
+        }
+        return rc;
+    }
+
+    check_PATH();
+    int any = 0;
+    for (int b = 0; b < PATHCACHE_BUCKETS; ++b) {
+        for (path_entry_t *e = g_buckets[b]; e; e = e->next) {
+            if (!any) out_printf("hits\tcommand\n");
+            any = 1;
+            out_printf("%4u\t%s\n", e->hits, e->path);
+        }
+    }
+    if (!any) out_printf("hash: hash table empty\n");
+    return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// Command hash table: command name -> absolute path, filled on first use.
+// Entries are dropped when PATH changes or when the cached file disappears.
+
+// Resolve cmd to an executable path. Names containing '/' are returned as-is.
+// Returns NULL if cmd is not found in PATH. The returned string stays valid
+// until the next path_lookup()/path_cache_clear() call.
+const char *path_lookup(const char *cmd);
+
+// Forget every cached entry
+void path_cache_clear(void);
+
+// Changes whenever a resolved path may have gone stale (PATH changed,
+// `hash -r`, an entry found missing); callers holding paths compare it
+unsigned path_cache_generation(void);
+
+// `hash` builtin:  hash | hash -r | hash name...
+int builtin_hash(char **argv);
@@ -0,0 +1,58 @@
+#define _GNU_SOURCE     // F_SETPIPE_SZ, O_DIRECT, pipe2
+#include "pipebuf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>     // SIZE_MAX
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+size_t g_pipe_size   = 0;
+int    g_pipe_packet = 0;
+
+int pipe_size_parse(const char *s, size_t *out) {
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 10);
+    if (end == s || errno) return -1;
+    unsigned shift = 0;
+    switch (tolower((unsigned char)*end)) {
+    case 'g': shift += 10; /* fall through */
+    case 'm': shift += 10; /* fall through */
+    case 'k': shift += 10; end++; break;
+    case '\0': break;
+    default: return -1;
+    }
+    if (*end) return -1;
+    if (v > SIZE_MAX >> shift) { errno = ERANGE; return -1; }
+    *out = (size_t)v << shift;
+    return 0;
+}
+
+// Ceiling for unprivileged F_SETPIPE_SZ, read once
+static long pipe_max_size(void) {
+    static long max = -1;
+    if (max < 0) {
+        FILE *f = fopen("/proc/sys/fs/pipe-max-size", "re");
+        if (!f || fscanf(f, "%ld", &max) != 1) max = 1L << 20;
+        if (f) fclose(f);
+    }
+    return max;
+}
+
+int pipe_open(int p[2], size_t size) {
+    // close-on-exec: a child gets its own ends through dup2() only
+    if (pipe2(p, O_CLOEXEC | (g_pipe_packet ? O_DIRECT : 0)) < 0) {
+        // packet mode needs kernel support; plain pipes still work
+        if (!g_pipe_packet || errno != EINVAL || pipe2(p, O_CLOEXEC) < 0) return -1;
+    }
+    if (size == 0) return 0;
+
+    if (fcntl(p[1], F_SETPIPE_SZ, (int)(size > (1U << 30) ? 1U << 30 : size)) < 0) {
+        if (errno == EPERM && (long)size > pipe_max_size())
+            (void)fcntl(p[1], F_SETPIPE_SZ, (int)pipe_max_size());
+        // otherwise (EBUSY: over the per-user quota) keep the default size
+    }
+    return 0;
+}
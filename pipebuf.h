@@ -0,0 +1,19 @@
+#pragma once
+#include <stddef.h>
+
+// Pipeline pipe tuning:
+//   shopt pipesz SIZE        grow every pipeline pipe to SIZE (64k, 1M, ...;
+//                            0 = kernel default) with F_SETPIPE_SZ
+//   shopt pipepacket on|off  create pipes with O_DIRECT (packet mode)
+//   pipesz=SIZE cmd | ...    override the size for one pipeline
+extern size_t g_pipe_size;
+extern int    g_pipe_packet;
+
+// Parse "65536", "64k", "1M" (k/m/g suffixes, case-insensitive).
+// Returns 0, or -1 if s is not a size or does not fit in a size_t.
+int pipe_size_parse(const char *s, size_t *out);
+
+// pipe() for a pipeline stage, sized to `size` bytes (0 = leave the kernel
+// default). Requests above /proc/sys/fs/pipe-max-size are clamped to it
+// for unprivileged users. Returns 0, or -1 with errno set (pipe failed).
+int pipe_open(int p[2], size_t size);
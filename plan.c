@@ -0,0 +1,98 @@
+#include "plan.h"
+#include "pathcache.h"  // path_lookup(), path_cache_generation()
+#include <stdlib.h>
+#include <string.h>
+
+#define PLAN_SLOTS 64   // direct-mapped: a colliding shape replaces the old one
+
+int g_plan_cache = 1;
+
+static plan_t *g_plans[PLAN_SLOTS];
+
+// FNV-1a over the stage names, each terminated by its NUL
+static unsigned shape_hash(char ***seq, int n) {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < n; i++) {
+        const char *s = seq[i][0];
+        do { h ^= (unsigned char)*s; h *= 16777619u; } while (*s++);
+    }
+    return h;
+}
+
+static int same_shape(const plan_t *p, unsigned h, char ***seq, int n) {
+    if (p->hash != h || p->nstages != n) return 0;
+    const char *s = p->names;
+    for (int i = 0; i < n; i++) {
+        if (strcmp(s, seq[i][0]) != 0) return 0;
+        s += strlen(s) + 1;
+    }
+    return 1;
+}
+
+static void plan_free(plan_t *p) {
+    if (!p) return;
+    for (int i = 0; i < p->nstages; i++) free((char *)p->stage[i].path);
+    free(p->names);
+    free(p);
+}
+
+static plan_t *compile(unsigned h, char ***seq, int n) {
+    size_t len = 0;
+    for (int i = 0; i < n; i++) len += strlen(seq[i][0]) + 1;
+
+    plan_t *p = calloc(1, sizeof(*p) + sizeof(plan_stage_t) * (size_t)n);
+    if (!p) return NULL;
+    p->names = malloc(len);
+    if (!p->names) { free(p); return NULL; }
+    p->hash = h;
+
+    char *o = p->names;
+    for (int i = 0; i < n; i++) {
+        const char *name = seq[i][0];
+        o = stpcpy(o, name) + 1;
+        p->nstages = i + 1;     // plan_free() frees this stage from here on
+
+        if ((p->stage[i].bi = builtin_find(name)) != NULL) continue;
+        // names with '/' and relative PATH hits are cheap or cwd-dependent:
+        // leave them to spawn time, like not-found names (which report there)
+        if (strchr(name, '/')) continue;
+        const char *path = path_lookup(name);
+        if (path && path[0] == '/' && !(p->stage[i].path = strdup(path))) {
+            plan_free(p);
+            return NULL;
+        }
+    }
+    p->gen = path_cache_generation();    // lookups above may have pruned entries
+    return p;
+}
+
+const plan_t *plan_get(char ***seq, int n) {
+    if (!g_plan_cache || n <= 0) return NULL;
+    for (int i = 0; i < n; i++) if (!seq[i] || !seq[i][0]) return NULL;
+
+    unsigned h = shape_hash(seq, n);
+    plan_t **slot = &g_plans[h % PLAN_SLOTS];
+    plan_t *p = *slot;
+    if (p && same_shape(p, h, seq, n) && p->gen == path_cache_generation()) {
+        p->hits++;
+        return p;
+    }
+    plan_free(p);
+    *slot = compile(h, seq, n);
+    return *slot;
+}
+
+void plan_invalidate(const plan_t *p) {
+    if (!p) return;
+    plan_t **slot = &g_plans[p->hash % PLAN_SLOTS];
+    if (*slot != p) return;
+    plan_free(*slot);
+    *slot = NULL;
+}
+
+void plan_cache_clear(void) {
+    for (int i = 0; i < PLAN_SLOTS; i++) {
+        plan_free(g_plans[i]);
+        g_plans[i] = NULL;
+    }
+}
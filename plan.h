@@ -0,0 +1,36 @@
+#pragma once
+#include "builtins.h"
+
+// Compiled pipeline plans: what a pipeline's setup derives from the names
+// of its stages (builtin or not, the resolved binary) is worked out once
+// per pipeline shape and reused while only the arguments change, so a loop
+// over `grep x $f | sort | uniq -c` skips the builtin and PATH lookups (and
+// the access() check per stage) on every iteration. Plans are keyed by a
+// hash of the stage names and dropped when the path cache moves on (PATH
+// changed, `hash -r`) or a cached binary fails to run.
+
+typedef struct {
+    const builtin_t *bi;        // builtin run in a forked child, or NULL
+    const char      *path;      // absolute binary path; NULL = look it up at spawn
+} plan_stage_t;
+
+typedef struct {
+    unsigned     hash;
+    unsigned     gen;           // path_cache_generation() when compiled
+    unsigned     hits;
+    int          nstages;
+    char        *names;         // argv[0] of each stage, NUL-separated
+    plan_stage_t stage[];
+} plan_t;
+
+extern int g_plan_cache;        // `shopt plancache on|off`
+
+// The plan for the n stages of seq, compiled on a miss. NULL when the cache
+// is off, a stage is empty or memory is short: resolve per stage.
+const plan_t *plan_get(char ***seq, int n);
+
+// Drop p (one of its paths failed to exec); it is recompiled on next use
+void plan_invalidate(const plan_t *p);
+
+// Forget every plan
+void plan_cache_clear(void);
@@ -0,0 +1,100 @@
+#include "redircache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define REDIR_CACHE_SIZE 16
+
+typedef struct {
+    char           *path;   // NULL = free slot
+    redir_mode_t    mode;
+    int             fd;     // O_CLOEXEC: never leaks into children
+    dev_t           dev;
+    ino_t           ino;
+    struct timespec mtime;  // as of the last use (REDIR_IN only)
+    unsigned long   used;   // LRU clock
+} redir_entry_t;
+
+int g_redir_cache = 1;
+
+static redir_entry_t g_cache[REDIR_CACHE_SIZE];
+static unsigned long g_clock;
+
+static const int open_flags[] = {
+    [REDIR_IN]     = O_RDONLY | O_CLOEXEC,
+    [REDIR_TRUNC]  = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+    [REDIR_APPEND] = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+};
+
+int redir_flags(redir_mode_t mode) {
+    return open_flags[mode];
+}
+
+static void drop(redir_entry_t *e) {
+    close(e->fd);
+    free(e->path);
+    e->path = NULL;
+}
+
+void redir_cache_clear(void) {
+    for (int i = 0; i < REDIR_CACHE_SIZE; ++i)
+        if (g_cache[i].path) drop(&g_cache[i]);
+}
+
+// Still the same file, and safe to hand out again?
+static int reusable(redir_entry_t *e) {
+    struct stat st;
+    if (stat(e->path, &st) < 0 || st.st_dev != e->dev || st.st_ino != e->ino) return 0;
+    if (e->mode == REDIR_IN &&
+        (st.st_mtim.tv_sec != e->mtime.tv_sec || st.st_mtim.tv_nsec != e->mtime.tv_nsec))
+        return 0;
+
+    if (e->mode == REDIR_TRUNC && ftruncate(e->fd, 0) < 0) return 0;
+    if (e->mode != REDIR_APPEND && lseek(e->fd, 0, SEEK_SET) < 0) return 0;
+    return 1;
+}
+
+// Remember fd (already open on path); keeps our own O_CLOEXEC duplicate
+static void insert(const char *path, redir_mode_t mode, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) return;
+
+    redir_entry_t *e = &g_cache[0];
+    for (int i = 0; i < REDIR_CACHE_SIZE; ++i) {
+        if (!g_cache[i].path) { e = &g_cache[i]; break; }
+        if (g_cache[i].used < e->used) e = &g_cache[i];
+    }
+    if (e->path) drop(e);
+
+    int keep = fcntl(fd, F_DUPFD_CLOEXEC, 3);
+    if (keep < 0) return;
+    if (!(e->path = strdup(path))) { close(keep); return; }
+    e->mode  = mode;
+    e->fd    = keep;
+    e->dev   = st.st_dev;
+    e->ino   = st.st_ino;
+    e->mtime = st.st_mtim;
+    e->used  = ++g_clock;
+}
+
+int redir_open(const char *path, redir_mode_t mode) {
+    if (!g_redir_cache) return open(path, open_flags[mode], 0644);
+
+    for (int i = 0; i < REDIR_CACHE_SIZE; ++i) {
+        redir_entry_t *e = &g_cache[i];
+        if (!e->path || e->mode != mode || strcmp(e->path, path) != 0) continue;
+        if (!reusable(e)) { drop(e); break; }
+
+        int fd = fcntl(e->fd, F_DUPFD_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        e->used = ++g_clock;
+        return fd;
+    }
+
+    int fd = open(path, open_flags[mode], 0644);
+    if (fd >= 0) insert(path, mode, fd);
+    return fd;
+}
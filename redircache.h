@@ -0,0 +1,27 @@
+#pragma once
+
+// Cache of open redirection targets, keyed by path and mode, so a script
+// that redirects to the same few files in a loop skips the open() (and on
+// network filesystems its lookup round trips). Only regular files are
+// kept. Before reuse the path is stat()ed and must still name the same
+// inode; read targets must also keep their mtime, otherwise they are
+// reopened. `shopt redircache off` disables and empties the cache.
+typedef enum {
+    REDIR_IN = 0,       // < file
+    REDIR_TRUNC,        // > file
+    REDIR_APPEND,       // >> file
+} redir_mode_t;
+
+extern int g_redir_cache;
+
+// open() replacement for a redirection. The fd belongs to the caller and is
+// closed as usual; it shares its file offset with the cached copy, which is
+// rewound (and for REDIR_TRUNC truncated) on every reuse, so only use it
+// for foreground commands. Returns -1 with errno set like open().
+int redir_open(const char *path, redir_mode_t mode);
+
+// open(2) flags for a mode
+int redir_flags(redir_mode_t mode);
+
+// Close every cached fd
+void redir_cache_clear(void);
@@ -0,0 +1,113 @@
+#include "remote.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>     // PATH_MAX
+#include <sys/stat.h>
+
+int g_remote_compress = 0;
+int g_remote_persist  = 60;
+
+int remote_is_stage(char **argv) {
+    return argv && argv[0] && argv[0][0] == '@' && argv[0][1];
+}
+
+// Words made only of these need no quoting for the remote sh
+static int plain_word(const char *w) {
+    if (!*w) return 0;
+    for (; *w; w++)
+        if (!strchr("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-./=:,+%@", *w))
+            return 0;
+    return 1;
+}
+
+// argv[1..] as one sh command line: 'it'\''s' style quoting
+static char *remote_command(arena_t *a, char **argv) {
+    size_t len = 1;
+    for (char **w = argv; *w; w++) len += strlen(*w) * 4 + 3;
+    char *out = arena_alloc(a, len), *o = out;
+    if (!out) return NULL;
+
+    for (char **w = argv; *w; w++) {
+        if (w != argv) *o++ = ' ';
+        if (plain_word(*w)) { o = stpcpy(o, *w); continue; }
+        *o++ = '\'';
+        for (const char *p = *w; *p; p++) {
+            if (*p == '\'') { o = stpcpy(o, "'\\''"); continue; }
+            *o++ = *p;
+        }
+        *o++ = '\'';
+    }
+    *o = '\0';
+    return out;
+}
+
+// Where the ControlMaster sockets live: $XDG_RUNTIME_DIR, else
+// /tmp/sh-ssh-UID if it is a 0700 directory of ours, else (someone else
+// made that name) a fresh mkdtemp() one. NULL if none can be had.
+static const char *control_dir(void) {
+    const char *xdg = getenv("XDG_RUNTIME_DIR");
+    if (xdg && *xdg) return xdg;
+
+    static char dir[PATH_MAX];
+    if (dir[0]) return dir;
+    snprintf(dir, sizeof(dir), "/tmp/sh-ssh-%u", (unsigned)getuid());
+    struct stat st;
+    if ((mkdir(dir, 0700) == 0 || errno == EEXIST) && lstat(dir, &st) == 0 &&
+        S_ISDIR(st.st_mode) && st.st_uid == getuid() && (st.st_mode & 077) == 0)
+        return dir;
+    snprintf(dir, sizeof(dir), "/tmp/sh-ssh-%u-XXXXXX", (unsigned)getuid());
+    if (mkdtemp(dir)) return dir;
+    perror("remote: mkdtemp");
+    dir[0] = '\0';
+    return NULL;
+}
+
+char **remote_argv(arena_t *a, char **argv) {
+    const char *host = argv[0] + 1;
+    if (host[0] == '-') {
+        fprintf(stderr, "%s: invalid host\n", argv[0]);
+        return NULL;
+    }
+    if (!argv[1]) {
+        fprintf(stderr, "%s: missing command\n", argv[0]);
+        return NULL;
+    }
+
+    // %C is ssh's hash of host, port and user: one socket per destination
+    char ctl[PATH_MAX + 32], persist[48];
+    const char *dir = control_dir();
+    if (!dir) return NULL;
+    snprintf(ctl, sizeof(ctl), "ControlPath=%s/sh-ssh-%%C", dir);
+    if (g_remote_persist > 0) snprintf(persist, sizeof(persist), "ControlPersist=%d", g_remote_persist);
+    else                      snprintf(persist, sizeof(persist), "ControlPersist=no");
+
+    char **out = arena_alloc(a, sizeof(char *) * 16);
+    char *cmd  = remote_command(a, argv + 1);
+    char *c    = arena_strndup(a, ctl, strlen(ctl));
+    char *p    = arena_strndup(a, persist, strlen(persist));
+    if (!out || !cmd || !c || !p) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return NULL;
+    }
+
+    size_t n = 0;
+    out[n++] = "ssh";
+    out[n++] = "-T";                // no pty: the channel carries raw bytes
+    out[n++] = "-e";                // and no escape character in them
+    out[n++] = "none";
+    out[n++] = "-o";
+    out[n++] = "ControlMaster=auto";
+    out[n++] = "-o";
+    out[n++] = c;
+    out[n++] = "-o";
+    out[n++] = p;
+    if (g_remote_compress) out[n++] = "-C";
+    out[n++] = (char *)host;
+    out[n++] = "--";
+    out[n++] = cmd;
+    out[n]   = NULL;
+    return out;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "arena.h"
+
+// Remote pipeline stages: a stage written `@host cmd args...` runs cmd on
+// host through ssh, with the stage's pipes as ssh's stdin/stdout, so the
+// data streams over the ssh channel (framed and windowed by ssh, and
+// compressed with `shopt remotecompress on`). Every stage to the same host
+// shares one multiplexed connection: the first opens a ControlMaster
+// socket under $XDG_RUNTIME_DIR (or a private 0700 directory in /tmp) and
+// later stages attach to it; it stays up for `shopt remotepersist SECONDS`
+// after the last one ends. Local stages keep plain pipes. The remote
+// command is quoted word by word for the remote shell; its exit status is
+// the stage's (255: ssh failed).
+
+extern int g_remote_compress;       // ssh -C
+extern int g_remote_persist;        // ControlPersist seconds (0 = close with the last stage)
+
+// 1 if argv is a `@host ...` stage
+int remote_is_stage(char **argv);
+
+// The ssh argv for a remote stage, from arena a; NULL after printing an
+// error (no command, host that looks like an option, out of memory)
+char **remote_argv(arena_t *a, char **argv);
@@ -0,0 +1,145 @@
+#include "strpool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define CHUNK_SIZE   (64 * 1024)
+#define ALIGN_UP(n)  (((n) + 7u) & ~(size_t)7u)
+
+typedef struct chunk {
+    size_t size;        // bytes in data[]
+    size_t used;
+    size_t live;        // strings still referenced
+    char   data[];
+} chunk_t;
+
+typedef struct istr {
+    chunk_t     *chunk;
+    struct istr *hnext;
+    uint32_t     hash;
+    uint32_t     refs;
+    size_t       len;
+    char         s[];
+} istr_t;
+
+static chunk_t  *g_cur;             // chunk new strings are carved from
+static istr_t  **g_table;
+static size_t    g_nbuckets;        // power of two
+static size_t    g_count;
+static size_t    g_bytes;
+
+static uint32_t fnv1a(const char *s, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) { h ^= (unsigned char)s[i]; h *= 16777619u; }
+    return h;
+}
+
+static istr_t *header_of(const char *s) {
+    return (istr_t *)(void *)(s - offsetof(istr_t, s));
+}
+
+static int grow_table(void) {
+    size_t nb = g_nbuckets ? g_nbuckets * 2 : 256;
+    istr_t **nt = calloc(nb, sizeof(*nt));
+    if (!nt) return -1;
+    for (size_t b = 0; b < g_nbuckets; ++b) {
+        istr_t *e = g_table[b];
+        while (e) {
+            istr_t *nx = e->hnext;
+            e->hnext = nt[e->hash & (nb - 1)];
+            nt[e->hash & (nb - 1)] = e;
+            e = nx;
+        }
+    }
+    free(g_table);
+    g_table = nt;
+    g_nbuckets = nb;
+    return 0;
+}
+
+static void chunk_put(chunk_t *c) {
+    if (--c->live > 0) return;
+    if (c == g_cur) { c->used = 0; return; }  // keep the current chunk, just rewind
+    g_bytes -= c->size;
+    free(c);
+}
+
+// Bump-allocate n bytes; oversized strings get a chunk of their own
+static void *arena_take(size_t n, chunk_t **owner) {
+    n = ALIGN_UP(n);
+    if (!g_cur || g_cur->size - g_cur->used < n) {
+        size_t sz = n > CHUNK_SIZE / 4 ? n : CHUNK_SIZE;
+        chunk_t *c = malloc(sizeof(chunk_t) + sz);
+        if (!c) return NULL;
+        c->size = sz;
+        c->used = 0;
+        c->live = 0;
+        g_bytes += sz;
+        if (sz == CHUNK_SIZE) {
+            // retire the old current chunk; free it right away if it is empty
+            chunk_t *old = g_cur;
+            g_cur = c;
+            if (old && old->live == 0) { g_bytes -= old->size; free(old); }
+        }
+        *owner = c;
+        c->used = n;
+        c->live = 1;
+        return c->data;
+    }
+    *owner = g_cur;
+    void *p = g_cur->data + g_cur->used;
+    g_cur->used += n;
+    g_cur->live++;
+    return p;
+}
+
+const char *str_intern(const char *s) {
+    if (!s) s = "";
+    size_t len = strlen(s);
+    uint32_t h = fnv1a(s, len);
+
+    if (g_nbuckets) {
+        for (istr_t *e = g_table[h & (g_nbuckets - 1)]; e; e = e->hnext) {
+            if (e->hash == h && e->len == len && memcmp(e->s, s, len) == 0) {
+                e->refs++;
+                return e->s;
+            }
+        }
+    }
+    if (g_count >= g_nbuckets && grow_table() < 0) return NULL;
+
+    chunk_t *c;
+    istr_t *e = arena_take(sizeof(istr_t) + len + 1, &c);
+    if (!e) return NULL;
+    e->chunk = c;
+    e->hash  = h;
+    e->refs  = 1;
+    e->len   = len;
+    memcpy(e->s, s, len + 1);
+
+    size_t b = h & (g_nbuckets - 1);
+    e->hnext = g_table[b];
+    g_table[b] = e;
+    g_count++;
+    return e->s;
+}
+
+const char *str_retain(const char *s) {
+    if (s) header_of(s)->refs++;
+    return s;
+}
+
+void str_release(const char *s) {
+    if (!s) return;
+    istr_t *e = header_of(s);
+    if (--e->refs > 0) return;
+
+    istr_t **pp = &g_table[e->hash & (g_nbuckets - 1)];
+    while (*pp != e) pp = &(*pp)->hnext;
+    *pp = e->hnext;
+    g_count--;
+    chunk_put(e->chunk);
+}
+
+size_t str_pool_count(void) { return g_count; }
+size_t str_pool_bytes(void) { return g_bytes; }
@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+
+// Interned, reference-counted strings carved out of arena chunks.
+// Equal strings share one copy; a chunk is freed once nothing in it is live.
+
+// Return the interned copy of s with one more reference (NULL on OOM)
+const char *str_intern(const char *s);
+
+// Take another reference on an interned string
+const char *str_retain(const char *s);
+
+// Drop a reference; the string's storage is recycled at zero. NULL is ignored.
+void str_release(const char *s);
+
+// Number of distinct live strings and bytes held in chunks (for diagnostics)
+size_t str_pool_count(void);
+size_t str_pool_bytes(void);
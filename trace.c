@@ -0,0 +1,117 @@
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef SHELL_TRACE
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+typedef struct {
+    _Atomic uint64_t seq;       // index + 1 once the slot is fully written
+    const char      *name;      // string literal; same address in children
+    uint64_t         t0, t1;    // CLOCK_MONOTONIC ns
+    int32_t          pid;
+    int32_t          instant;   // TRACE_MARK(): t0 only
+} trace_ev_t;
+
+typedef struct {
+    _Atomic uint64_t head;      // events ever recorded
+    trace_ev_t       ev[TRACE_RING_SIZE];
+} trace_ring_t;
+
+static trace_ring_t *g_ring;
+
+// Shared with every child forked after the first event
+static trace_ring_t *ring(void) {
+    if (!g_ring) {
+        void *p = mmap(NULL, sizeof(trace_ring_t), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return NULL;
+        g_ring = p;
+    }
+    return g_ring;
+}
+
+uint64_t trace_now(void) {
+    if (!g_ring) (void)ring();      // map before the first fork
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void record(const char *name, uint64_t t0, uint64_t t1, int instant) {
+    trace_ring_t *r = ring();
+    if (!r) return;
+    uint64_t i = atomic_fetch_add_explicit(&r->head, 1, memory_order_relaxed);
+    trace_ev_t *e = &r->ev[i & (TRACE_RING_SIZE - 1)];
+    atomic_store_explicit(&e->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);      // seq = 0 lands before the fields
+    e->name    = name;
+    e->t0      = t0;
+    e->t1      = t1;
+    e->pid     = (int32_t)getpid();
+    e->instant = instant;
+    atomic_store_explicit(&e->seq, i + 1, memory_order_release);
+}
+
+void trace_record(const char *name, uint64_t t0, uint64_t t1) {
+    record(name, t0, t1, 0);
+}
+
+void trace_mark(const char *name) {
+    uint64_t t = trace_now();
+    record(name, t, t, 1);
+}
+
+static void dump(FILE *f) {
+    trace_ring_t *r = ring();
+    uint64_t head  = r ? atomic_load_explicit(&r->head, memory_order_acquire) : 0;
+    uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+    fprintf(f, "{\"traceEvents\":[");
+    int n = 0;
+    for (uint64_t i = first; i < head; ++i) {
+        trace_ev_t *e = &r->ev[i & (TRACE_RING_SIZE - 1)];
+        // seqlock read: copy, then keep the copy only if seq did not move
+        if (atomic_load_explicit(&e->seq, memory_order_acquire) != i + 1) continue;  // torn/overwritten
+        const char *name = e->name;
+        uint64_t t0 = e->t0, t1 = e->t1;
+        int32_t pid = e->pid, instant = e->instant;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&e->seq, memory_order_relaxed) != i + 1) continue;  // rewritten meanwhile
+        if (instant)
+            fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    n++ ? "," : "", name, (double)t0 / 1e3, pid, pid);
+        else
+            fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    n++ ? "," : "", name, (double)t0 / 1e3, (double)(t1 - t0) / 1e3,
+                    pid, pid);
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ns\"}\n");
+}
+
+int builtin_trace(char **argv) {
+    if (argv[1] && strcmp(argv[1], "-c") == 0) {
+        trace_ring_t *r = ring();
+        if (r) memset(r, 0, sizeof(*r));
+        return 0;
+    }
+    if (!argv[1]) { dump(stdout); return 0; }
+
+    FILE *f = fopen(argv[1], "we");
+    if (!f) { perror(argv[1]); return 1; }
+    dump(f);
+    return fclose(f) == 0 ? 0 : 1;
+}
+
+#else
+
+int builtin_trace(char **argv) {
+    (void)argv;
+    fprintf(stderr, "trace: not compiled in (build with -DSHELL_TRACE)\n");
+    return 1;
+}
+
+#endif
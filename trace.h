@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+
+// Per-phase launch tracing. Build with -DSHELL_TRACE to enable; otherwise
+// every macro below compiles to nothing.
+//
+//     TRACE_DECL(t0);              // take a timestamp
+//     ...phase...
+//     TRACE_SPAN("fork", t0);      // record [t0, now] as "fork"
+//     TRACE_MARK("execve");        // a point in time, e.g. right before exec
+//
+// Events go to a lock-free ring in a MAP_SHARED mapping, so forked children
+// (dup2/exec phases) land in the same buffer as the shell.
+
+#define TRACE_RING_SIZE 8192        // events kept; a power of two
+
+#ifdef SHELL_TRACE
+uint64_t trace_now(void);
+void     trace_record(const char *name, uint64_t t0, uint64_t t1);
+void     trace_mark(const char *name);
+#define TRACE_DECL(var)         uint64_t var = trace_now()
+#define TRACE_SPAN(name, var)   trace_record((name), (var), trace_now())
+#define TRACE_MARK(name)        trace_mark(name)
+#else
+#define TRACE_DECL(var)
+#define TRACE_SPAN(name, var)   ((void)0)
+#define TRACE_MARK(name)        ((void)0)
+#endif
+
+// `trace` builtin: trace [-c] [file] — dump the ring as Chrome/Perfetto JSON
+// (to stdout or file); -c clears it
+int builtin_trace(char **argv);
@@ -0,0 +1,236 @@
+#include "uring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/io_uring.h>
+
+// Kernel 6.7 opcode; older uapi headers do not name it
+#ifndef IORING_OP_WAITID
+#define IORING_OP_WAITID 50
+#endif
+
+#define URING_ENTRIES 64
+#define URING_WAITS   (URING_ENTRIES - 1)   // waitids per batch, next to a watch poll
+#define URING_WATCH   (~0ULL)               // user_data of the watch poll
+
+typedef struct {
+    int                  fd;
+    unsigned            *sq_tail, *sq_mask, *sq_array;
+    unsigned            *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    int                  has_waitid, has_openat;
+    int                  watch_fd;      // fd of the armed watch poll, -1 if none
+} ring_t;
+
+int g_wait_uring = 0;
+
+static ring_t g_ring = { .fd = -1, .watch_fd = -1 };
+
+static int sys_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned submit, unsigned wait) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait,
+                        wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+static int probe_ops(ring_t *r) {
+    size_t sz = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *p = calloc(1, sz);
+    if (!p) return -1;
+    int rc = (int)syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PROBE, p, 256);
+    if (rc == 0) {
+        r->has_waitid = p->ops_len > IORING_OP_WAITID &&
+                        (p->ops[IORING_OP_WAITID].flags & IO_URING_OP_SUPPORTED);
+        r->has_openat = p->ops_len > IORING_OP_OPENAT &&
+                        (p->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(p);
+    return rc;
+}
+
+int uring_init(void) {
+    if (g_ring.fd >= 0) return 0;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = sys_setup(URING_ENTRIES, &p);
+    if (fd < 0) { perror("io_uring_setup"); return -1; }
+    (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    size_t sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP && cq_sz > sq_sz) sq_sz = cq_sz;
+
+    char *sq = mmap(NULL, sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_SQ_RING);
+    char *cq = sq;
+    if (sq != MAP_FAILED && !(p.features & IORING_FEAT_SINGLE_MMAP))
+        cq = mmap(NULL, cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  fd, IORING_OFF_CQ_RING);
+    void *sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+        // the mappings hold the ring open; it only goes away with the shell
+        perror("io_uring mmap");
+        close(fd);
+        return -1;
+    }
+
+    ring_t r = {
+        .fd       = fd,
+        .sq_tail  = (unsigned *)(sq + p.sq_off.tail),
+        .sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask),
+        .sq_array = (unsigned *)(sq + p.sq_off.array),
+        .cq_head  = (unsigned *)(cq + p.cq_off.head),
+        .cq_tail  = (unsigned *)(cq + p.cq_off.tail),
+        .cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask),
+        .sqes     = sqes,
+        .cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes),
+        .watch_fd = -1,
+    };
+    if (probe_ops(&r) < 0) { perror("io_uring probe"); close(fd); return -1; }
+    g_ring = r;
+    return 0;
+}
+
+int uring_can_wait(void) {
+    return g_ring.fd >= 0 && g_ring.has_waitid;
+}
+
+static struct io_uring_sqe *next_sqe(unsigned k) {
+    unsigned tail = *g_ring.sq_tail + k, idx = tail & *g_ring.sq_mask;
+    struct io_uring_sqe *sqe = &g_ring.sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    g_ring.sq_array[idx] = idx;
+    return sqe;
+}
+
+// Queue a one-shot POLL_ADD on fd after the k sqes already prepared. It
+// stays armed across calls until it fires; returns 1 if one was queued.
+static unsigned arm_watch(unsigned k, int fd) {
+    if (fd < 0 || g_ring.watch_fd == fd) return 0;
+    struct io_uring_sqe *sqe = next_sqe(k);
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data     = URING_WATCH;
+    g_ring.watch_fd    = fd;
+    return 1;
+}
+
+// Publish n prepared sqes and wait for their completions; cqe results are
+// stored by user_data index. Entries the kernel refused to take are
+// withdrawn and keep -ECANCELED. With watch_fd >= 0, on_watch() runs each
+// time it becomes readable meanwhile.
+static void submit_and_wait(unsigned n, int *res, int watch_fd, void (*on_watch)(void)) {
+    for (unsigned i = 0; i < n; ++i) res[i] = -ECANCELED;
+    unsigned last_watch = arm_watch(n, watch_fd);     // the newest sqe is the poll
+    __atomic_store_n(g_ring.sq_tail, *g_ring.sq_tail + n + last_watch, __ATOMIC_RELEASE);
+
+    unsigned pending = n + last_watch, want = n, done = 0;
+    while (done < want) {
+        // while watching, wake on any completion so the poll is seen at once
+        int rc = sys_enter(g_ring.fd, pending, watch_fd >= 0 ? 1 : want - done);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            // take back what was not consumed, wait for the rest
+            unsigned lost = pending;
+            if (last_watch && lost) { g_ring.watch_fd = -1; lost--; }
+            want -= lost;
+            __atomic_store_n(g_ring.sq_tail, *g_ring.sq_tail - pending, __ATOMIC_RELEASE);
+            pending = 0;
+        } else {
+            pending -= (unsigned)rc < pending ? (unsigned)rc : pending;
+        }
+
+        int fired = 0;
+        unsigned head = *g_ring.cq_head;
+        while (head != __atomic_load_n(g_ring.cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &g_ring.cqes[head & *g_ring.cq_mask];
+            if (cqe->user_data == URING_WATCH) {
+                g_ring.watch_fd = -1;
+                fired = 1;
+            } else if (cqe->user_data < n) {
+                res[cqe->user_data] = cqe->res;
+                done++;
+            }
+            head++;
+        }
+        __atomic_store_n(g_ring.cq_head, head, __ATOMIC_RELEASE);
+
+        if (fired && on_watch) on_watch();
+        if (done < want && (last_watch = arm_watch(0, watch_fd)) != 0) {
+            __atomic_store_n(g_ring.sq_tail, *g_ring.sq_tail + 1, __ATOMIC_RELEASE);
+            pending++;
+        }
+    }
+}
+
+// siginfo from waitid() back to a wait(2) status word
+static int wait_status(const siginfo_t *si) {
+    switch (si->si_code) {
+    case CLD_EXITED: return (si->si_status & 0xff) << 8;
+    case CLD_DUMPED: return (si->si_status & 0x7f) | 0x80;
+    default:         return si->si_status & 0x7f;
+    }
+}
+
+int uring_wait_children(const pid_t *pids, int n, int *status, int watch_fd, void (*on_watch)(void)) {
+    if ((g_ring.fd < 0 && uring_init() < 0) || !g_ring.has_waitid) return -1;
+
+    siginfo_t info[URING_WAITS];
+    int res[URING_WAITS];
+    for (int base = 0; base < n; base += URING_WAITS) {
+        unsigned k = (unsigned)(n - base < URING_WAITS ? n - base : URING_WAITS);
+        for (unsigned i = 0; i < k; ++i) {
+            struct io_uring_sqe *sqe = next_sqe(i);
+            memset(&info[i], 0, sizeof(info[i]));
+            sqe->opcode     = IORING_OP_WAITID;
+            sqe->fd         = pids[base + (int)i];
+            sqe->len        = P_PID;
+            sqe->file_index = WEXITED;
+            sqe->addr2      = (unsigned long)&info[i];
+            sqe->user_data  = i;
+        }
+        submit_and_wait(k, res, watch_fd, on_watch);
+        for (unsigned i = 0; i < k; ++i) {
+            int *st = &status[base + (int)i];
+            if (res[i] >= 0) { *st = wait_status(&info[i]); continue; }
+            // refused or failed: reap it the classic way
+            while (waitpid(pids[base + (int)i], st, 0) < 0) {
+                if (errno != EINTR) { *st = EXIT_FAILURE << 8; break; }
+            }
+        }
+    }
+    return 0;
+}
+
+int uring_open_batch(const char *const *paths, const int *flags, int n, int *fds) {
+    if ((g_ring.fd < 0 && uring_init() < 0) || !g_ring.has_openat || n > URING_ENTRIES)
+        return -1;
+
+    for (int i = 0; i < n; ++i) {
+        struct io_uring_sqe *sqe = next_sqe((unsigned)i);
+        sqe->opcode     = IORING_OP_OPENAT;
+        sqe->fd         = AT_FDCWD;
+        sqe->addr       = (unsigned long)paths[i];
+        sqe->open_flags = (unsigned)flags[i];
+        sqe->len        = 0644;
+        sqe->user_data  = (unsigned)i;
+        // in order: a failed open cancels the ones after it
+        if (i < n - 1) sqe->flags = IOSQE_IO_LINK;
+    }
+    submit_and_wait((unsigned)n, fds, -1, NULL);
+    return 0;
+}
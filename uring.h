@@ -0,0 +1,33 @@
+#pragma once
+#include <sys/types.h>
+
+// Minimal io_uring backend (raw syscalls, no liburing), selected with
+// `shopt wait uring`: foreground pipeline stages are reaped with one batch
+// of IORING_OP_WAITID requests and uncached redirections are opened with
+// one batch of IORING_OP_OPENAT, instead of a syscall per process / file.
+// `shopt wait uring` is refused on kernels without IORING_OP_WAITID; the
+// opens fall back to open() when OPENAT is missing.
+
+// Non-zero once `shopt wait uring` is in effect
+extern int g_wait_uring;
+
+// Create the ring and check the kernel supports the opcodes we use.
+// Returns 0, or -1 (message printed) if io_uring cannot be used.
+int uring_init(void);
+
+// 1 if the kernel reaps children through the ring (IORING_OP_WAITID,
+// Linux 6.7+); only meaningful after uring_init() succeeded
+int uring_can_wait(void);
+
+// Reap the n children in pids, storing wait(2)-style statuses. With
+// watch_fd >= 0 a POLL_ADD on it shares the ring, and on_watch() runs
+// whenever it turns readable during the wait (the job table's epoll fd:
+// background jobs are reaped meanwhile). Returns 0, or -1 if the ring
+// cannot wait (nothing reaped: use wait4 instead).
+int uring_wait_children(const pid_t *pids, int n, int *status, int watch_fd, void (*on_watch)(void));
+
+// Open n paths at once, in order; fds[i] gets the fd or -errno. After a
+// failure the rest are -ECANCELED; -ECANCELED alone means not attempted
+// (open it yourself). Returns 0, or -1 if the ring is
+// unavailable (nothing opened).
+int uring_open_batch(const char *const *paths, const int *flags, int n, int *fds);
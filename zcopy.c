@@ -0,0 +1,221 @@
+#define _GNU_SOURCE     // splice, tee, copy_file_range
+#include "zcopy.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+#define ZC_CHUNK (1 << 20)     // bytes requested per splice/tee/copy call
+
+zc_kind_t zc_classify(char **argv) {
+    if (!argv || !argv[0]) return ZC_NONE;
+
+    zc_kind_t k;
+    int i = 1;
+    if (strcmp(argv[0], "cat") == 0) {
+        k = ZC_CAT;
+    } else if (strcmp(argv[0], "tee") == 0) {
+        k = ZC_TEE;
+        if (argv[1] && strcmp(argv[1], "-a") == 0) i = 2;
+    } else {
+        return ZC_NONE;
+    }
+
+    // any option we don't implement -> run the real utility
+    for (; argv[i]; ++i)
+        if (argv[i][0] == '-' && argv[i][1] != '\0') return ZC_NONE;
+    return k;
+}
+
+static int is_pipe(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+static int is_reg(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static int write_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) { if (errno == EINTR) continue; return -1; }
+        p += w; n -= (size_t)w;
+    }
+    return 0;
+}
+
+// Userspace fallback for fd pairs the zero-copy calls don't accept
+static int copy_rw(int in, int out) {
+    char buf[65536];
+    for (;;) {
+        ssize_t r = read(in, buf, sizeof(buf));
+        if (r == 0) return 0;
+        if (r < 0) { if (errno == EINTR) continue; return -1; }
+        if (write_all(out, buf, (size_t)r) < 0) return -1;
+    }
+}
+
+// in -> out, picking the cheapest mechanism the two fds allow.
+// Returns 0 on EOF, -1 on error (errno set).
+static int copy_fd(int in, int out) {
+    if (is_reg(in) && is_reg(out)) {
+        for (;;) {
+            ssize_t n = copy_file_range(in, NULL, out, NULL, ZC_CHUNK, 0);
+            if (n == 0) return 0;
+            if (n > 0) continue;
+            if (errno == EINTR) continue;
+            // EBADF: O_APPEND destination, which copy_file_range refuses
+            if (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP || errno == EBADF) break;
+            return -1;
+        }
+    } else if (is_pipe(in) || is_pipe(out)) {
+        for (;;) {
+            ssize_t n = splice(in, NULL, out, NULL, ZC_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (n == 0) return 0;
+            if (n > 0) continue;
+            if (errno == EINTR) continue;
+            // e.g. a tty on the other side, or an O_APPEND file
+            if (errno == EINVAL || errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP) break;
+            return -1;
+        }
+    }
+    return copy_rw(in, out);
+}
+
+// Consume exactly n bytes from pipe `in` into `out`. *spliced drops to 0
+// once splice refuses `out` (O_APPEND file, some filesystems), and the
+// rest goes through read/write.
+static int drain_to(int in, int out, size_t n, int *spliced) {
+    char buf[65536];
+    while (n > 0) {
+        ssize_t m;
+        if (*spliced) {
+            m = splice(in, NULL, out, NULL, n, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (m < 0 && (errno == EINVAL || errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP)) {
+                *spliced = 0;
+                continue;
+            }
+        } else {
+            m = read(in, buf, n < sizeof(buf) ? n : sizeof(buf));
+            if (m > 0 && write_all(out, buf, (size_t)m) < 0) return -1;
+        }
+        if (m < 0) { if (errno == EINTR) continue; return -1; }
+        if (m == 0) return -1;
+        n -= (size_t)m;
+    }
+    return 0;
+}
+
+static int run_cat(char **argv, int in, int out) {
+    if (!argv[1]) {
+        if (copy_fd(in, out) < 0 && errno != EPIPE) { perror("cat"); return 1; }
+        return 0;
+    }
+
+    int rc = 0;
+    for (int i = 1; argv[i]; ++i) {
+        int fd = in;
+        if (strcmp(argv[i], "-") != 0) {
+            fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+            if (fd < 0) { fprintf(stderr, "cat: %s: %s\n", argv[i], strerror(errno)); rc = 1; continue; }
+        }
+        int err = copy_fd(fd, out) < 0 ? errno : 0;
+        if (fd != in) close(fd);
+        if (err == EPIPE) break;
+        if (err) { fprintf(stderr, "cat: %s: %s\n", argv[i], strerror(err)); rc = 1; }
+    }
+    return rc;
+}
+
+static int run_tee(char **argv, int in, int out) {
+    int i = 1, flags = O_WRONLY | O_CREAT | O_TRUNC;
+    if (argv[1] && strcmp(argv[1], "-a") == 0) { flags = O_WRONLY | O_CREAT | O_APPEND; i = 2; }
+
+    int fds[64], nfds = 0, rc = 0;
+    for (; argv[i]; ++i) {
+        if (nfds == (int)(sizeof(fds) / sizeof(fds[0]))) {
+            fprintf(stderr, "tee: too many files\n");
+            rc = 1;
+            break;
+        }
+        int fd = open(argv[i], flags | O_CLOEXEC, 0644);
+        if (fd < 0) { fprintf(stderr, "tee: %s: %s\n", argv[i], strerror(errno)); rc = 1; continue; }
+        fds[nfds++] = fd;
+    }
+
+    if (nfds == 0) {
+        if (copy_fd(in, out) < 0 && errno != EPIPE) { perror("tee"); rc = 1; }
+    } else if (nfds == 1 && is_pipe(in) && is_pipe(out)) {
+        // tee(2) duplicates into `out` without consuming, then splice drains into the file
+        int spliced = 1;
+        for (;;) {
+            ssize_t n = tee(in, out, ZC_CHUNK, 0);
+            if (n == 0) break;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EPIPE) { perror("tee"); rc = 1; }
+                break;
+            }
+            if (drain_to(in, fds[0], (size_t)n, &spliced) < 0) { perror("tee"); rc = 1; break; }
+        }
+    } else {
+        char buf[65536];
+        int out_ok = 1;
+        for (;;) {
+            ssize_t r = read(in, buf, sizeof(buf));
+            if (r == 0) break;
+            if (r < 0) { if (errno == EINTR) continue; perror("tee"); rc = 1; break; }
+            if (out_ok && write_all(out, buf, (size_t)r) < 0) {
+                if (errno != EPIPE) { perror("tee"); rc = 1; }
+                out_ok = 0;     // like tee(1): keep feeding the files
+            }
+            for (int k = 0; k < nfds; ++k)
+                if (fds[k] >= 0 && write_all(fds[k], buf, (size_t)r) < 0) {
+                    perror("tee");
+                    rc = 1;
+                    close(fds[k]);
+                    fds[k] = -1;
+                }
+        }
+    }
+
+    for (int k = 0; k < nfds; ++k) if (fds[k] >= 0) close(fds[k]);
+    return rc;
+}
+
+int zc_copy(int in, int out) {
+    struct sigaction ign = { .sa_handler = SIG_IGN }, old;
+    sigemptyset(&ign.sa_mask);
+    sigaction(SIGPIPE, &ign, &old);
+    int rc = copy_fd(in, out);
+    int saved = errno;
+    sigaction(SIGPIPE, &old, NULL);
+    errno = saved;
+    return rc;
+}
+
+int zc_run(zc_kind_t kind, char **argv, int in, int out) {
+    // a reader that goes away must end the stage, not kill the shell
+    struct sigaction ign = { .sa_handler = SIG_IGN }, old;
+    sigemptyset(&ign.sa_mask);
+    sigaction(SIGPIPE, &ign, &old);
+
+    int rc = 1;
+    switch (kind) {
+    case ZC_CAT: rc = run_cat(argv, in, out); break;
+    case ZC_TEE: rc = run_tee(argv, in, out); break;
+    case ZC_NONE: break;
+    }
+
+    sigaction(SIGPIPE, &old, NULL);
+    return rc;
+}
+
+int zc_main(char **argv) {
+    return zc_run(zc_classify(argv), argv, STDIN_FILENO, STDOUT_FILENO);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Stages run by a forked copy of the shell instead of exec'ing a utility,
+// moving bytes kernel-to-kernel with splice(2) / tee(2) /
+// copy_file_range(2).
+typedef enum {
+    ZC_NONE = 0,    // not handled in-process
+    ZC_CAT,         // cat [file|-]...   (no args: plain passthrough)
+    ZC_TEE,         // tee [-a] [file]...
+} zc_kind_t;
+
+// Classify a stage; anything with unsupported options stays ZC_NONE
+zc_kind_t zc_classify(char **argv);
+
+// Copy in to out until EOF with the cheapest call the two fds allow
+// (SIGPIPE ignored meanwhile). Returns 0, or -1 with errno set.
+int zc_copy(int in, int out);
+
+// Run the stage in the shell: read `in`, write `out`.
+// Does not close in/out. Returns 0 on success, 1 on any error.
+int zc_run(zc_kind_t kind, char **argv, int in, int out);
+
+// spawn_req_t.builtin for a cat/tee stage: runs it on fds 0 and 1 of the
+// forked child, which sits in the pipeline's process group and takes ^C
+// like any other stage. Returns 0 on success, 1 on any error.
+int zc_main(char **argv);